@@ -0,0 +1,351 @@
+#include "pch.h"
+#include "DatCache.h"
+
+#include "gdrv.h"
+#include "GroupData.h"
+#include "options.h"
+#include "partman.h"
+#include "StartupProfile.h"
+#include "winmain.h"
+#include "zdrv.h"
+
+std::string DatCache::HashedPath;
+uint64_t DatCache::DatHash = 0;
+uint64_t DatCache::DatSize = 0;
+
+static const char CacheMagic[8]{'S', 'C', 'P', 'B', 'C', 'A', 'C', 'H'};
+
+
+DatFile* DatCache::Load(const std::string& datPath, bool fullTiltMode, int resolution)
+{
+	// The hash is kept for Save, a miss is followed by a cold load of the same file.
+	HashedPath.clear();
+	auto datMapping = MappedFile::Open(datPath.c_str());
+	if (datMapping == nullptr)
+		return nullptr;
+	DatHash = HashData(datMapping->Data(), datMapping->Size());
+	DatSize = datMapping->Size();
+	HashedPath = datPath;
+	delete datMapping;
+
+	auto cachePath = CachePath(datPath, resolution);
+	auto cache = MappedFile::Open(cachePath.c_str());
+	if (cache == nullptr)
+		return nullptr;
+
+	DatReader reader{cache->Data(), cache->Size(), 0, false};
+	auto header = reader.Read<DatCacheHeader>();
+	header.GameVersion[sizeof header.GameVersion - 1] = '\0';
+	if (reader.Failed || memcmp(header.Magic, CacheMagic, sizeof CacheMagic) != 0 ||
+		header.FormatVersion != FormatVersion || strcmp(header.GameVersion, winmain::Version) != 0 ||
+		header.DatHash != DatHash || header.DatSize != DatSize || header.Resolution != resolution ||
+		header.Flags != HeaderFlags(fullTiltMode))
+	{
+		StartupProfile::Detail("%s is stale", cachePath.c_str());
+		delete cache;
+		return nullptr;
+	}
+
+	auto readString = [&reader]()
+	{
+		auto length = reader.Read<uint32_t>();
+		auto str = reader.Take(length);
+		reader.Align(8);
+		return str ? std::string(str, length) : std::string();
+	};
+
+	auto datFile = new DatFile();
+	datFile->CacheMapping = cache;
+	datFile->FromCache = true;
+	datFile->FileName = datPath;
+	datFile->ResolutionLoaded[resolution] = true;
+	datFile->AppName = readString();
+	datFile->Description = readString();
+
+	for (auto index = 0u; !reader.Failed && index < header.DeferredCount; index++)
+	{
+		auto deferred = reader.Read<DatCacheDeferred>();
+		datFile->DeferredEntries.push_back({
+			deferred.GroupIndex, static_cast<FieldTypes>(deferred.EntryType), static_cast<uint8_t>(deferred.Resolution),
+			static_cast<long>(deferred.Offset), static_cast<size_t>(deferred.FieldSize)
+		});
+	}
+
+	auto views = 0;
+	datFile->Groups.reserve(header.GroupCount);
+	for (auto groupIndex = 0u; !reader.Failed && groupIndex < header.GroupCount; groupIndex++)
+	{
+		auto groupHeader = reader.Read<DatCacheGroup>();
+		auto group = new GroupData(groupHeader.GroupId);
+		group->ReserveEntries(groupHeader.EntryCount);
+		datFile->Groups.push_back(group);
+
+		for (auto entryIndex = 0u; !reader.Failed && entryIndex < groupHeader.EntryCount; entryIndex++)
+		{
+			auto entryHeader = reader.Read<DatCacheEntry>();
+			auto payload = reader.Take(static_cast<size_t>(entryHeader.PayloadSize));
+			reader.Align(8);
+			if (!payload)
+				break;
+
+			DatReader payloadReader{payload, static_cast<size_t>(entryHeader.PayloadSize), 0, false};
+			auto entryType = static_cast<FieldTypes>(entryHeader.EntryType);
+			char* buffer;
+			auto ownsBuffer = true;
+			if (entryType == FieldTypes::Bitmap8bit)
+			{
+				auto bmp = ReadBitmap(payloadReader);
+				if (bmp && !bmp->IndexedOwned)
+					views++;
+				buffer = reinterpret_cast<char*>(bmp);
+			}
+			else if (entryType == FieldTypes::Bitmap16bit)
+			{
+				buffer = reinterpret_cast<char*>(ReadZMap(payloadReader));
+			}
+			else
+			{
+				// Copied, table code is free to write into its fields.
+				buffer = datFile->AllocateField(payloadReader.Size);
+				memcpy(buffer, payload, payloadReader.Size);
+				ownsBuffer = false;
+			}
+
+			if (!buffer)
+			{
+				reader.Failed = true;
+				break;
+			}
+			auto entryData = new EntryData(entryType, buffer);
+			entryData->FieldSize = entryHeader.FieldSize;
+			entryData->OwnsBuffer = ownsBuffer;
+			group->AddProcessedEntry(entryData);
+		}
+		group->FinalizeGroup();
+	}
+
+	for (const auto& deferred : datFile->DeferredEntries)
+	{
+		if (deferred.GroupIndex < 0 || deferred.GroupIndex >= static_cast<int>(datFile->Groups.size()))
+			reader.Failed = true;
+	}
+	if (reader.Failed)
+	{
+		StartupProfile::Detail("%s is truncated", cachePath.c_str());
+		delete datFile;
+		return nullptr;
+	}
+
+	datFile->BuildLabelIndex();
+	if (!views)
+	{
+		delete datFile->CacheMapping;
+		datFile->CacheMapping = nullptr;
+	}
+	StartupProfile::Detail("loaded %s", cachePath.c_str());
+	return datFile;
+}
+
+bool DatCache::Save(const DatFile* datFile, bool fullTiltMode, int resolution)
+{
+	if (HashedPath.empty() || HashedPath != datFile->FileName)
+		return false;
+
+	std::vector<char> buffer;
+	auto write = [&buffer](const void* data, size_t size)
+	{
+		auto src = static_cast<const char*>(data);
+		buffer.insert(buffer.end(), src, src + size);
+	};
+	auto align = [&buffer]()
+	{
+		buffer.resize((buffer.size() + 7) & ~static_cast<size_t>(7));
+	};
+	auto writeString = [&](const std::string& str)
+	{
+		auto length = static_cast<uint32_t>(str.length());
+		write(&length, sizeof length);
+		write(str.c_str(), length);
+		align();
+	};
+
+	DatCacheHeader header{};
+	memcpy(header.Magic, CacheMagic, sizeof CacheMagic);
+	header.FormatVersion = FormatVersion;
+	header.Flags = HeaderFlags(fullTiltMode);
+	strncpy(header.GameVersion, winmain::Version, sizeof header.GameVersion - 1);
+	header.DatHash = DatHash;
+	header.DatSize = DatSize;
+	header.Resolution = resolution;
+	header.GroupCount = static_cast<uint32_t>(datFile->Groups.size());
+	header.DeferredCount = static_cast<uint32_t>(datFile->DeferredEntries.size());
+	write(&header, sizeof header);
+	writeString(datFile->AppName);
+	writeString(datFile->Description);
+
+	for (const auto& deferred : datFile->DeferredEntries)
+	{
+		DatCacheDeferred cached{};
+		cached.GroupIndex = deferred.GroupIndex;
+		cached.EntryType = static_cast<uint32_t>(deferred.EntryType);
+		cached.Resolution = deferred.Resolution;
+		cached.Offset = deferred.Offset;
+		cached.FieldSize = deferred.FieldSize;
+		write(&cached, sizeof cached);
+	}
+
+	for (const auto group : datFile->Groups)
+	{
+		DatCacheGroup groupHeader{group->GroupId, static_cast<uint32_t>(group->EntryCount())};
+		write(&groupHeader, sizeof groupHeader);
+
+		for (const auto entry : group->GetEntries())
+		{
+			// Payload size is patched in once the payload is written.
+			auto headerOffset = buffer.size();
+			DatCacheEntry entryHeader{static_cast<uint32_t>(entry->EntryType), entry->FieldSize, 0};
+			write(&entryHeader, sizeof entryHeader);
+			auto payloadOffset = buffer.size();
+
+			if (entry->EntryType == FieldTypes::Bitmap8bit)
+			{
+				auto bmp = reinterpret_cast<const gdrv_bitmap8*>(entry->Buffer);
+				if (bmp->Stride != bmp->Width || !bmp->BmpBufPtr1)
+					return false;
+
+				DatCacheBitmap info{};
+				info.Width = bmp->Width;
+				info.Height = bmp->Height;
+				info.IndexedStride = bmp->IndexedStride;
+				info.XPosition = bmp->XPosition;
+				info.YPosition = bmp->YPosition;
+				info.BitmapType = static_cast<uint32_t>(bmp->BitmapType);
+				info.Resolution = bmp->Resolution;
+				info.IndexedSize = bmp->IndexedBmpPtr ? bmp->IndexedStride * bmp->Height : 0;
+				info.SpanCount = static_cast<uint32_t>(bmp->OpaqueSpans.size());
+				info.RowSpanCount = static_cast<uint32_t>(bmp->RowSpans.size());
+				write(&info, sizeof info);
+				write(bmp->IndexedBmpPtr, info.IndexedSize);
+				align();
+				write(bmp->BmpBufPtr1, bmp->Stride * bmp->Height * sizeof(ColorRgba));
+				write(bmp->OpaqueSpans.data(), bmp->OpaqueSpans.size() * sizeof(gdrv_span));
+				align();
+				write(bmp->RowSpans.data(), bmp->RowSpans.size() * sizeof(int));
+			}
+			else if (entry->EntryType == FieldTypes::Bitmap16bit)
+			{
+				auto zMap = reinterpret_cast<const zmap_header_type*>(entry->Buffer);
+				DatCacheZMap info{zMap->Width, zMap->Height, zMap->Stride, zMap->Resolution};
+				write(&info, sizeof info);
+				write(zMap->ZPtr1, zMap->Stride * zMap->Height * sizeof(uint16_t));
+			}
+			else
+			{
+				if (entry->FieldSize < 0)
+					return false;
+				write(entry->Buffer, entry->FieldSize);
+			}
+
+			entryHeader.PayloadSize = buffer.size() - payloadOffset;
+			memcpy(&buffer[headerOffset], &entryHeader, sizeof entryHeader);
+			align();
+		}
+	}
+
+	// Written next to the cache and renamed, a crash mid-write leaves no truncated cache behind.
+	auto cachePath = CachePath(datFile->FileName, resolution);
+	auto tempPath = cachePath + ".tmp";
+	auto fileHandle = fopenu(tempPath.c_str(), "wb");
+	if (fileHandle == nullptr)
+		return false;
+	auto written = fwrite(buffer.data(), 1, buffer.size(), fileHandle);
+	fclose(fileHandle);
+	std::remove(cachePath.c_str());
+	if (written != buffer.size() || std::rename(tempPath.c_str(), cachePath.c_str()) != 0)
+	{
+		std::remove(tempPath.c_str());
+		return false;
+	}
+
+	StartupProfile::Detail("saved %s, %zu KiB", cachePath.c_str(), buffer.size() / 1024);
+	return true;
+}
+
+gdrv_bitmap8* DatCache::ReadBitmap(DatReader& reader)
+{
+	auto info = reader.Read<DatCacheBitmap>();
+	auto indexed = reader.Take(info.IndexedSize);
+	reader.Align(8);
+	auto pixels = reader.Take(static_cast<size_t>(info.Width) * info.Height * sizeof(ColorRgba));
+	auto spans = reader.Take(info.SpanCount * sizeof(gdrv_span));
+	reader.Align(8);
+	auto rowSpans = reader.Take(info.RowSpanCount * sizeof(int));
+	if (reader.Failed || info.Width < 0 || info.Height < 0 || info.Resolution > 2 ||
+		(info.IndexedSize && info.IndexedSize != static_cast<uint32_t>(info.IndexedStride * info.Height)))
+		return nullptr;
+
+	auto bmp = new gdrv_bitmap8(info.Width, info.Height, false, true);
+	bmp->IndexedStride = info.IndexedStride;
+	bmp->XPosition = info.XPosition;
+	bmp->YPosition = info.YPosition;
+	bmp->BitmapType = static_cast<BitmapTypes>(info.BitmapType);
+	bmp->Resolution = info.Resolution;
+	if (indexed && info.IndexedSize)
+	{
+		// Only read by display_palette, safe to point into the cache.
+		bmp->IndexedBmpPtr = const_cast<char*>(indexed);
+		bmp->IndexedOwned = false;
+	}
+	memcpy(bmp->BmpBufPtr1, pixels, static_cast<size_t>(info.Width) * info.Height * sizeof(ColorRgba));
+	auto spanPtr = reinterpret_cast<const gdrv_span*>(spans);
+	bmp->OpaqueSpans.assign(spanPtr, spanPtr + info.SpanCount);
+	auto rowSpanPtr = reinterpret_cast<const int*>(rowSpans);
+	bmp->RowSpans.assign(rowSpanPtr, rowSpanPtr + info.RowSpanCount);
+	return bmp;
+}
+
+zmap_header_type* DatCache::ReadZMap(DatReader& reader)
+{
+	auto info = reader.Read<DatCacheZMap>();
+	if (reader.Failed || info.Width < 0 || info.Height < 0 || info.Stride < info.Width || info.Resolution > 2)
+		return nullptr;
+
+	auto depths = reader.Take(static_cast<size_t>(info.Stride) * info.Height * sizeof(uint16_t));
+	if (!depths)
+		return nullptr;
+
+	auto zMap = new zmap_header_type(info.Width, info.Height, info.Stride);
+	zMap->Resolution = info.Resolution;
+	memcpy(zMap->ZPtr1, depths, static_cast<size_t>(info.Stride) * info.Height * sizeof(uint16_t));
+	return zMap;
+}
+
+std::string DatCache::CachePath(const std::string& datPath, int resolution)
+{
+	auto separator = datPath.find_last_of("/\\");
+	auto datName = separator == std::string::npos ? datPath : datPath.substr(separator + 1);
+	return winmain::PrefPath + datName + "." + std::to_string(resolution) + ".cache";
+}
+
+uint64_t DatCache::HashData(const char* data, size_t size)
+{
+	// FNV-1a over 8 byte words, only needs to notice a changed file, not resist attacks.
+	const uint64_t prime = 1099511628211ull;
+	uint64_t hash = 14695981039346656037ull;
+	size_t index = 0;
+	for (; index + sizeof(uint64_t) <= size; index += sizeof(uint64_t))
+	{
+		uint64_t word;
+		memcpy(&word, data + index, sizeof word);
+		hash = (hash ^ word) * prime;
+	}
+	for (; index < size; index++)
+		hash = (hash ^ static_cast<uint8_t>(data[index])) * prime;
+	return hash;
+}
+
+uint32_t DatCache::HeaderFlags(bool fullTiltMode)
+{
+	// Cached bitmaps carry indexed pixels only when they are kept at runtime.
+	return (fullTiltMode ? 1u : 0u) | (options::Options.PaletteBakedBitmaps ? 0u : 2u);
+}
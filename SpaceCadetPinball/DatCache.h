@@ -0,0 +1,91 @@
+#pragma once
+
+class DatFile;
+struct DatReader;
+struct gdrv_bitmap8;
+struct zmap_header_type;
+
+
+// Cache layout: header, AppName and Description strings, deferred entries, then groups with their entries.
+// Every record starts 8 byte aligned, bitmap pixels and zMap depths are stored as they are used at runtime.
+struct DatCacheHeader
+{
+	char Magic[8];
+	uint32_t FormatVersion;
+	uint32_t Flags;
+	char GameVersion[16];
+	uint64_t DatHash;
+	uint64_t DatSize;
+	int32_t Resolution;
+	uint32_t GroupCount;
+	uint32_t DeferredCount;
+	uint32_t Reserved;
+};
+
+struct DatCacheDeferred
+{
+	int32_t GroupIndex;
+	uint32_t EntryType;
+	uint32_t Resolution;
+	uint32_t Reserved;
+	int64_t Offset;
+	uint64_t FieldSize;
+};
+
+struct DatCacheGroup
+{
+	int32_t GroupId;
+	uint32_t EntryCount;
+};
+
+struct DatCacheEntry
+{
+	uint32_t EntryType;
+	int32_t FieldSize;
+	uint64_t PayloadSize;
+};
+
+// Followed by indexed pixels (when kept), 32bpp pixels, opaque spans and row span offsets.
+struct DatCacheBitmap
+{
+	int32_t Width;
+	int32_t Height;
+	int32_t IndexedStride;
+	int32_t XPosition;
+	int32_t YPosition;
+	uint32_t BitmapType;
+	uint32_t Resolution;
+	uint32_t IndexedSize;
+	uint32_t SpanCount;
+	uint32_t RowSpanCount;
+};
+
+// Followed by Stride * Height depth values, already flipped.
+struct DatCacheZMap
+{
+	int32_t Width;
+	int32_t Height;
+	int32_t Stride;
+	uint32_t Resolution;
+};
+
+// Processed table assets saved in the pref path after a cold start: palette applied bitmaps, split spliced
+// bitmaps, flipped zMaps, the embedded font groups and plain fields, in final group order.
+// A cache is valid for one .dat content hash, game version, resolution and indexed bitmap setting.
+class DatCache
+{
+public:
+	static DatFile* Load(const std::string& datPath, bool fullTiltMode, int resolution);
+	static bool Save(const DatFile* datFile, bool fullTiltMode, int resolution);
+	static uint64_t HashData(const char* data, size_t size);
+private:
+	static const uint32_t FormatVersion = 1;
+	static std::string HashedPath;
+	static uint64_t DatHash;
+	static uint64_t DatSize;
+
+	static gdrv_bitmap8* ReadBitmap(DatReader& reader);
+	static zmap_header_type* ReadZMap(DatReader& reader);
+	static std::string CachePath(const std::string& datPath, int resolution);
+	static uint32_t HeaderFlags(bool fullTiltMode);
+};
@@ -127,6 +127,10 @@ void DebugOverlay::DrawOverlay()
 	if (options::Options.DebugOverlayAabb)
 		DrawComponentAabb();
 
+	// Draw rolling graphs of render counters
+	if (options::Options.DebugOverlayRenderStats)
+		DrawRenderStats();
+
 	// Restore render target
 	SDL_SetRenderTarget(winmain::Renderer, initialRenderTarget);
 	SDL_SetRenderDrawColor(winmain::Renderer,
@@ -295,6 +299,41 @@ void DebugOverlay::DrawComponentAabb()
 	}
 }
 
+void DebugOverlay::DrawRenderStats()
+{
+	// One graph per counter, stacked in the top left corner, each scaled to its own maximum.
+	static const SDL_Color Colors[]
+	{
+		{255, 255, 0, 255}, {0, 255, 255, 255}, {255, 128, 0, 255},
+		{0, 255, 0, 255}, {255, 0, 255, 255}, {255, 255, 255, 255},
+	};
+	constexpr int GraphWidth = 128, GraphHeight = 24, Margin = 4;
+
+	SDL_Point points[GraphWidth];
+	for (auto index = 0; index < static_cast<int>(RenderStat::Count); index++)
+	{
+		auto stat = static_cast<RenderStat>(index);
+		float maxValue = 1;
+		for (auto age = 0; age < GraphWidth; age++)
+			maxValue = std::max(maxValue, render::StatValue(stat, age));
+
+		auto top = Margin + index * (GraphHeight + Margin);
+		SDL_Rect frame{Margin, top, GraphWidth, GraphHeight};
+		SDL_SetRenderDrawColor(winmain::Renderer, 0, 0, 0, 160);
+		SDL_RenderFillRect(winmain::Renderer, &frame);
+
+		for (auto age = 0; age < GraphWidth; age++)
+		{
+			auto value = render::StatValue(stat, age) / maxValue;
+			points[age].x = Margin + GraphWidth - 1 - age;
+			points[age].y = top + GraphHeight - 1 - static_cast<int>(value * (GraphHeight - 1));
+		}
+		const auto& color = Colors[index];
+		SDL_SetRenderDrawColor(winmain::Renderer, color.r, color.g, color.b, color.a);
+		SDL_RenderDrawLines(winmain::Renderer, points, GraphWidth);
+	}
+}
+
 void DebugOverlay::DrawCicleType(circle_type& circle)
 {
 	vector2 linePt{ circle.Center.X + sqrt(circle.RadiusSq), circle.Center.Y };
@@ -23,4 +23,5 @@ private:
 	static void DrawSoundPositions();
 	static void DrawBallDepthSteps();
 	static void DrawComponentAabb();
+	static void DrawRenderStats();
 };
\ No newline at end of file
@@ -0,0 +1,160 @@
+#include "pch.h"
+#include "EventTrace.h"
+
+#include "pb.h"
+#include "TPinballComponent.h"
+
+bool EventTrace::Recording = false;
+std::vector<TraceEvent> EventTrace::Buffer;
+size_t EventTrace::WriteIndex = 0, EventTrace::Count = 0;
+
+
+void EventTrace::Scope::Begin(TraceEventType type, const char* name, int code, float value)
+{
+	Event.Type = type;
+	Event.Name = name;
+	Event.Code = code;
+	Event.Value = value;
+	Event.TimeTicks = pb::time_ticks;
+	Event.Start = SDL_GetPerformanceCounter();
+}
+
+void EventTrace::Scope::Begin(TPinballComponent* component, MessageCode code, float value)
+{
+	Begin(TraceEventType::Message, component->GroupName, static_cast<int>(code), value);
+}
+
+void EventTrace::Scope::End()
+{
+	// Recording could have been stopped by the traced event itself.
+	if (!Recording)
+		return;
+
+	Event.Duration = SDL_GetPerformanceCounter() - Event.Start;
+	Push(Event);
+}
+
+void EventTrace::Start()
+{
+	if (Buffer.empty())
+		Buffer.resize(BufferSize);
+	Recording = true;
+}
+
+void EventTrace::Stop()
+{
+	Recording = false;
+}
+
+void EventTrace::Clear()
+{
+	WriteIndex = Count = 0;
+}
+
+void EventTrace::Instant(TraceEventType type, const char* name, int code, float value)
+{
+	if (!Recording)
+		return;
+
+	TraceEvent event{};
+	event.Type = type;
+	event.Name = name;
+	event.Code = code;
+	event.Value = value;
+	event.TimeTicks = pb::time_ticks;
+	event.Start = SDL_GetPerformanceCounter();
+	Push(event);
+}
+
+size_t EventTrace::EventCount()
+{
+	return Count;
+}
+
+bool EventTrace::ExportChromeTrace(const std::string& fileName)
+{
+	auto fileHandle = fopenu(fileName.c_str(), "w");
+	if (!fileHandle)
+		return false;
+
+	// Oldest event is at WriteIndex when the ring has wrapped around.
+	auto first = Count < Buffer.size() ? 0 : WriteIndex;
+	uint64_t origin = UINT64_MAX;
+	for (size_t index = 0; index < Count; index++)
+		origin = std::min(origin, Buffer[(first + index) % Buffer.size()].Start);
+
+	const auto usPerTick = 1000000.0 / static_cast<double>(SDL_GetPerformanceFrequency());
+	fprintf(fileHandle, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	for (size_t index = 0; index < Count; index++)
+	{
+		const auto& event = Buffer[(first + index) % Buffer.size()];
+		auto name = JsonEscape(event.Name ? event.Name : "table");
+		auto ts = static_cast<double>(event.Start - origin) * usPerTick;
+		if (event.Type == TraceEventType::Sound)
+		{
+			fprintf(fileHandle, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":1,",
+			        name.c_str(), TypeName(event.Type), ts);
+		}
+		else
+		{
+			fprintf(fileHandle, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1,",
+			        name.c_str(), TypeName(event.Type), ts, static_cast<double>(event.Duration) * usPerTick);
+		}
+		fprintf(fileHandle, "\"args\":{\"code\":%d,\"value\":%g,\"time_ticks\":%d}}%s\n",
+		        event.Code, event.Value, event.TimeTicks, index + 1 < Count ? "," : "");
+	}
+	fprintf(fileHandle, "]}\n");
+	fclose(fileHandle);
+	return true;
+}
+
+void EventTrace::Push(const TraceEvent& event)
+{
+	Buffer[WriteIndex] = event;
+	WriteIndex = (WriteIndex + 1) % Buffer.size();
+	if (Count < Buffer.size())
+		Count++;
+}
+
+const char* EventTrace::TypeName(TraceEventType type)
+{
+	switch (type)
+	{
+	case TraceEventType::Message:
+		return "message";
+	case TraceEventType::TimerFire:
+		return "timer";
+	case TraceEventType::ControlHandler:
+		return "control";
+	case TraceEventType::Sound:
+		return "sound";
+	default:
+		return "unknown";
+	}
+}
+
+std::string EventTrace::JsonEscape(const char* text)
+{
+	// Names come from the .dat file. Bytes outside ASCII are taken as Latin-1, the output stays valid UTF-8.
+	std::string result;
+	for (; *text; text++)
+	{
+		auto ch = static_cast<unsigned char>(*text);
+		if (ch == '"' || ch == '\\')
+		{
+			result += '\\';
+			result += static_cast<char>(ch);
+		}
+		else if (ch < 0x20 || ch >= 0x80)
+		{
+			char buffer[8];
+			snprintf(buffer, sizeof buffer, "\\u%04x", ch);
+			result += buffer;
+		}
+		else
+		{
+			result += static_cast<char>(ch);
+		}
+	}
+	return result;
+}
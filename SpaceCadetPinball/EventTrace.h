@@ -0,0 +1,79 @@
+#pragma once
+
+class TPinballComponent;
+enum class MessageCode;
+
+enum class TraceEventType : uint8_t
+{
+	Message,
+	TimerFire,
+	ControlHandler,
+	Sound,
+};
+
+struct TraceEvent
+{
+	uint64_t Start;
+	uint64_t Duration;
+	const char* Name;
+	int Code;
+	float Value;
+	int TimeTicks;
+	TraceEventType Type;
+};
+
+class EventTrace
+{
+public:
+	// Records the duration of one event, nested scopes show up as cascades in the timeline.
+	class Scope
+	{
+	public:
+		Scope(TraceEventType type, const char* name, int code, float value)
+		{
+			Active = Recording;
+			if (Active)
+				Begin(type, name, code, value);
+		}
+
+		Scope(TPinballComponent* component, MessageCode code, float value)
+		{
+			Active = Recording;
+			if (Active)
+				Begin(component, code, value);
+		}
+
+		~Scope()
+		{
+			if (Active)
+				End();
+		}
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	private:
+		bool Active;
+		TraceEvent Event;
+
+		void Begin(TraceEventType type, const char* name, int code, float value);
+		void Begin(TPinballComponent* component, MessageCode code, float value);
+		void End();
+	};
+
+	static bool Recording;
+
+	static void Start();
+	static void Stop();
+	static void Clear();
+	static void Instant(TraceEventType type, const char* name, int code, float value);
+	static size_t EventCount();
+	static bool ExportChromeTrace(const std::string& fileName);
+private:
+	static constexpr size_t BufferSize = 1 << 16;
+	static std::vector<TraceEvent> Buffer;
+	static size_t WriteIndex, Count;
+
+	static void Push(const TraceEvent& event);
+	static const char* TypeName(TraceEventType type);
+	static std::string JsonEscape(const char* text);
+};
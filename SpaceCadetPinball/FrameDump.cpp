@@ -0,0 +1,281 @@
+#include "pch.h"
+#include "FrameDump.h"
+
+#include "gdrv.h"
+#include "options.h"
+#include "pb.h"
+#include "render.h"
+#include "winmain.h"
+
+bool FrameDump::Active = false;
+std::string FrameDump::ScriptPath, FrameDump::OutDir, FrameDump::GoldenDir;
+std::vector<FrameDumpInput> FrameDump::Inputs;
+std::vector<int> FrameDump::DumpTicks;
+int FrameDump::EndTick = 0;
+float FrameDump::StepMs = 10.0f;
+bool FrameDump::Demo = false;
+
+
+bool FrameDump::Init(LPCSTR cmdLine)
+{
+	auto arg = strstr(cmdLine, "-framedump");
+	if (!arg)
+		return false;
+
+	arg += strlen("-framedump");
+	while (*arg == ' ')
+		arg++;
+	auto end = strchr(arg, ' ');
+	ScriptPath = end ? std::string(arg, end) : std::string(arg);
+	Active = true;
+	return true;
+}
+
+int FrameDump::Run()
+{
+	if (!LoadScript())
+		return 1;
+
+	std::stable_sort(Inputs.begin(), Inputs.end(), [](const FrameDumpInput& lhs, const FrameDumpInput& rhs)
+	{
+		return lhs.Tick < rhs.Tick;
+	});
+	std::sort(DumpTicks.begin(), DumpTicks.end());
+	for (auto tick : DumpTicks)
+		EndTick = std::max(EndTick, tick);
+
+	auto csvName = OutDir + "render_update.csv";
+	auto csv = fopenu(csvName.c_str(), "w");
+	if (!csv)
+	{
+		printf("FrameDump: could not create %s\n", csvName.c_str());
+		return 1;
+	}
+	fprintf(csv, "frame,time_ticks,update_ms,dirty_sprites,dirty_tiles,dirty_area,depth_tested,pixels_written,"
+	        "ball_save_bytes\n");
+
+	// Light shows use rand(), a fixed seed keeps runs comparable.
+	srand(1);
+	if (Demo)
+		pb::toggle_demo();
+	else
+		pb::replay_level(false);
+
+	size_t nextInput = 0, nextDump = 0;
+	auto frame = 0, mismatches = 0, missing = 0;
+	while (pb::time_ticks < EndTick)
+	{
+		for (; nextInput < Inputs.size() && Inputs[nextInput].Tick <= pb::time_ticks; nextInput++)
+		{
+			const auto& input = Inputs[nextInput];
+			for (const auto& gameInput : options::Options.Key[~input.Binding].Inputs)
+			{
+				if (gameInput.Type == InputTypes::None)
+					continue;
+				if (input.Down)
+					pb::InputDown(gameInput);
+				else
+					pb::InputUp(gameInput);
+				break;
+			}
+		}
+
+		pb::frame(StepMs);
+		const auto& stats = render::LastUpdate;
+		fprintf(csv, "%d,%d,%.4f,%d,%d,%lld,%lld,%lld,%lld\n", frame, pb::time_ticks, stats.Milliseconds,
+		        stats.DirtySprites, stats.DirtyTiles, static_cast<long long>(stats.DirtyArea),
+		        static_cast<long long>(stats.DepthTested), static_cast<long long>(stats.PixelsWritten),
+		        static_cast<long long>(stats.BallSaveBytes));
+		frame++;
+
+		// A dump tick is saved on the first frame that reaches it.
+		for (; nextDump < DumpTicks.size() && DumpTicks[nextDump] <= pb::time_ticks; nextDump++)
+		{
+			auto name = "frame_" + std::to_string(DumpTicks[nextDump]) + ".ppm";
+			if (!WritePpm(OutDir + name, *render::vscreen))
+				printf("FrameDump: could not write %s\n", (OutDir + name).c_str());
+			if (GoldenDir.empty())
+				continue;
+
+			auto diff = ComparePpm(GoldenDir + name, *render::vscreen);
+			if (diff < 0)
+				missing++;
+			else if (diff > 0)
+				mismatches++;
+		}
+	}
+	fclose(csv);
+
+	printf("FrameDump: %d frames, %d dumps, %d mismatched, %d missing golden images\n",
+	       frame, static_cast<int>(DumpTicks.size()), mismatches, missing);
+	return mismatches || missing ? 2 : 0;
+}
+
+bool FrameDump::LoadScript()
+{
+	auto fileHandle = fopenu(ScriptPath.c_str(), "r");
+	if (!fileHandle)
+	{
+		printf("FrameDump: could not open script %s\n", ScriptPath.c_str());
+		return false;
+	}
+
+	OutDir = winmain::PrefPath;
+	char line[512], command[32], value[448], binding[32];
+	auto lineNumber = 0;
+	auto result = true;
+	while (fgets(line, sizeof line, fileHandle))
+	{
+		lineNumber++;
+		if (sscanf(line, "%31s", command) != 1 || command[0] == '#')
+			continue;
+
+		int tick;
+		auto ok = true;
+		if (!strcmp(command, "out") || !strcmp(command, "golden"))
+		{
+			ok = sscanf(line, "%*s %447s", value) == 1;
+			if (ok)
+			{
+				std::string dir = value;
+				if (dir.back() != '/' && dir.back() != '\\')
+					dir += '/';
+				if (command[0] == 'o')
+					OutDir = dir;
+				else
+					GoldenDir = dir;
+			}
+		}
+		else if (!strcmp(command, "step"))
+		{
+			ok = sscanf(line, "%*s %f", &StepMs) == 1 && StepMs > 0.0f && StepMs <= 100.0f;
+		}
+		else if (!strcmp(command, "end"))
+		{
+			ok = sscanf(line, "%*s %d", &EndTick) == 1;
+		}
+		else if (!strcmp(command, "demo"))
+		{
+			Demo = true;
+		}
+		else if (!strcmp(command, "dump"))
+		{
+			ok = sscanf(line, "%*s %d", &tick) == 1;
+			if (ok)
+				DumpTicks.push_back(tick);
+		}
+		else if (!strcmp(command, "input"))
+		{
+			FrameDumpInput input{};
+			ok = sscanf(line, "%*s %d %447s %31s", &input.Tick, value, binding) == 3 &&
+				(!strcmp(value, "down") || !strcmp(value, "up")) && ParseBinding(binding, input.Binding);
+			input.Down = !strcmp(value, "down");
+			if (ok)
+				Inputs.push_back(input);
+		}
+		else
+		{
+			ok = false;
+		}
+
+		if (!ok)
+		{
+			printf("FrameDump: %s:%d: could not parse \"%s\"\n", ScriptPath.c_str(), lineNumber, command);
+			result = false;
+		}
+	}
+	fclose(fileHandle);
+	return result;
+}
+
+bool FrameDump::ParseBinding(const char* name, GameBindings& binding)
+{
+	static const char* const Names[]
+	{
+		"LeftFlipper", "RightFlipper", "Plunger", "LeftTableBump", "RightTableBump", "BottomTableBump", "NewGame",
+		"TogglePause",
+	};
+
+	for (auto index = 0u; index < sizeof Names / sizeof Names[0]; index++)
+	{
+		if (!strcmp(name, Names[index]))
+		{
+			binding = static_cast<GameBindings>(index);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FrameDump::WritePpm(const std::string& fileName, const gdrv_bitmap8& bmp)
+{
+	auto fileHandle = fopenu(fileName.c_str(), "wb");
+	if (!fileHandle)
+		return false;
+
+	fprintf(fileHandle, "P6\n%d %d\n255\n", bmp.Width, bmp.Height);
+	std::vector<uint8_t> row(bmp.Width * 3);
+	for (auto y = 0; y < bmp.Height; y++)
+	{
+		auto src = &bmp.BmpBufPtr1[y * bmp.Stride];
+		for (auto x = 0; x < bmp.Width; x++)
+		{
+			row[x * 3] = src[x].GetRed();
+			row[x * 3 + 1] = src[x].GetGreen();
+			row[x * 3 + 2] = src[x].GetBlue();
+		}
+		fwrite(row.data(), 1, row.size(), fileHandle);
+	}
+	fclose(fileHandle);
+	return true;
+}
+
+int FrameDump::ComparePpm(const std::string& fileName, const gdrv_bitmap8& bmp)
+{
+	auto fileHandle = fopenu(fileName.c_str(), "rb");
+	if (!fileHandle)
+	{
+		printf("FrameDump: missing golden image %s\n", fileName.c_str());
+		return -1;
+	}
+
+	int width, height, maxValue;
+	if (fscanf(fileHandle, "P6 %d %d %d", &width, &height, &maxValue) != 3 || maxValue != 255 ||
+		width != bmp.Width || height != bmp.Height || fgetc(fileHandle) == EOF)
+	{
+		printf("FrameDump: %s is not a %dx%d PPM\n", fileName.c_str(), bmp.Width, bmp.Height);
+		fclose(fileHandle);
+		return -1;
+	}
+
+	// Pixel-exact, the first difference is reported to help find the sprite responsible.
+	std::vector<uint8_t> row(width * 3);
+	auto diffCount = 0, firstX = -1, firstY = -1;
+	for (auto y = 0; y < height; y++)
+	{
+		if (fread(row.data(), 1, row.size(), fileHandle) != row.size())
+		{
+			diffCount += (height - y) * width;
+			break;
+		}
+
+		auto src = &bmp.BmpBufPtr1[y * bmp.Stride];
+		for (auto x = 0; x < width; x++)
+		{
+			if (row[x * 3] == src[x].GetRed() && row[x * 3 + 1] == src[x].GetGreen() &&
+				row[x * 3 + 2] == src[x].GetBlue())
+				continue;
+
+			if (diffCount++ == 0)
+			{
+				firstX = x;
+				firstY = y;
+			}
+		}
+	}
+	fclose(fileHandle);
+
+	if (diffCount)
+		printf("FrameDump: %s differs in %d pixels, first at %d,%d\n", fileName.c_str(), diffCount, firstX, firstY);
+	return diffCount;
+}
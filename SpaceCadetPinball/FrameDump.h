@@ -0,0 +1,36 @@
+#pragma once
+
+enum class GameBindings;
+struct gdrv_bitmap8;
+
+struct FrameDumpInput
+{
+	int Tick;
+	bool Down;
+	GameBindings Binding;
+};
+
+// Headless input replay that saves vScreen at chosen ticks and compares it against golden images.
+// Started with -framedump <script>, script lines:
+//   out <dir>, golden <dir>, step <ms>, end <tick>, demo,
+//   dump <tick>, input <tick> down|up <binding>.
+class FrameDump
+{
+public:
+	static bool Active;
+
+	static bool Init(LPCSTR cmdLine);
+	static int Run();
+private:
+	static std::string ScriptPath, OutDir, GoldenDir;
+	static std::vector<FrameDumpInput> Inputs;
+	static std::vector<int> DumpTicks;
+	static int EndTick;
+	static float StepMs;
+	static bool Demo;
+
+	static bool LoadScript();
+	static bool ParseBinding(const char* name, GameBindings& binding);
+	static bool WritePpm(const std::string& fileName, const gdrv_bitmap8& bmp);
+	static int ComparePpm(const std::string& fileName, const gdrv_bitmap8& bmp);
+};
@@ -5,7 +5,9 @@
 #include "EmbeddedData.h"
 #include "fullscrn.h"
 #include "gdrv.h"
+#include "partman.h"
 #include "pb.h"
+#include "WorkerPool.h"
 #include "zdrv.h"
 
 
@@ -21,7 +23,7 @@ EntryData::~EntryData()
 		{
 			delete reinterpret_cast<zmap_header_type*>(Buffer);
 		}
-		else
+		else if (OwnsBuffer)
 			delete[] Buffer;
 	}
 }
@@ -34,7 +36,6 @@ GroupData::GroupData(int groupId)
 
 void GroupData::AddEntry(EntryData* entry)
 {
-	auto addEntry = true;
 	switch (entry->EntryType)
 	{
 	case FieldTypes::GroupName:
@@ -42,51 +43,127 @@ void GroupData::AddEntry(EntryData* entry)
 		break;
 	case FieldTypes::Bitmap8bit:
 		{
+			// Spliced bitmaps are split in FinalizeGroup, which can run on a worker thread.
 			auto srcBmp = reinterpret_cast<gdrv_bitmap8*>(entry->Buffer);
 			if (srcBmp->BitmapType == BitmapTypes::Spliced)
-			{
-				// Get rid of spliced bitmap early on, to simplify render pipeline
-				auto bmp = new gdrv_bitmap8(srcBmp->Width, srcBmp->Height, true);
-				auto zMap = new zmap_header_type(srcBmp->Width, srcBmp->Height, srcBmp->Width);
-				SplitSplicedBitmap(*srcBmp, *bmp, *zMap);
-
-				NeedsSort = true;
-				addEntry = false;
-				AddEntry(new EntryData(FieldTypes::Bitmap8bit, reinterpret_cast<char*>(bmp)));
-				AddEntry(new EntryData(FieldTypes::Bitmap16bit, reinterpret_cast<char*>(zMap)));
-				delete entry;
-			}
+				PendingEntries.push_back(entry);
 			else
-			{
 				SetBitmap(srcBmp);
-			}
 			break;
 		}
 	case FieldTypes::Bitmap16bit:
 		{
-			SetZMap(reinterpret_cast<zmap_header_type*>(entry->Buffer));
+			// Flipped in FinalizeGroup, for the same reason.
+			PendingEntries.push_back(entry);
 			break;
 		}
 	default: break;
 	}
 
-	if (addEntry)
-		Entries.push_back(entry);
+	if (!Entries.empty() && entry->EntryType < Entries.back()->EntryType)
+		NeedsSort = true;
+	Entries.push_back(entry);
+	FieldsIndexed = false;
+}
+
+void GroupData::AddProcessedEntry(EntryData* entry)
+{
+	// Entries from DatCache are already split, flipped and in final order.
+	switch (entry->EntryType)
+	{
+	case FieldTypes::GroupName:
+		GroupName = entry->Buffer;
+		break;
+	case FieldTypes::Bitmap8bit:
+		{
+			auto bmp = reinterpret_cast<gdrv_bitmap8*>(entry->Buffer);
+			Bitmaps[bmp->Resolution] = bmp;
+			break;
+		}
+	case FieldTypes::Bitmap16bit:
+		{
+			auto zMap = reinterpret_cast<zmap_header_type*>(entry->Buffer);
+			ZMaps[zMap->Resolution] = zMap;
+			break;
+		}
+	default: break;
+	}
+	Entries.push_back(entry);
 }
 
 void GroupData::FinalizeGroup()
 {
+	// Only touches this group, safe to run for different groups in parallel.
+	for (auto entry : PendingEntries)
+	{
+		if (entry->EntryType == FieldTypes::Bitmap16bit)
+		{
+			SetZMap(reinterpret_cast<zmap_header_type*>(entry->Buffer));
+			continue;
+		}
+
+		// Get rid of spliced bitmap early on, to simplify render pipeline
+		auto srcBmp = reinterpret_cast<gdrv_bitmap8*>(entry->Buffer);
+		auto bmp = new gdrv_bitmap8(srcBmp->Width, srcBmp->Height, true);
+		auto zMap = new zmap_header_type(srcBmp->Width, srcBmp->Height, srcBmp->Width);
+		SplitSplicedBitmap(*srcBmp, *bmp, *zMap);
+		SetBitmap(bmp);
+		SetZMap(zMap);
+
+		// Split pair takes the place of the spliced entry.
+		auto position = std::find(Entries.begin(), Entries.end(), entry);
+		*position = new EntryData(FieldTypes::Bitmap8bit, reinterpret_cast<char*>(bmp));
+		Entries.insert(position + 1, new EntryData(FieldTypes::Bitmap16bit, reinterpret_cast<char*>(zMap)));
+		NeedsSort = true;
+		delete entry;
+	}
+	PendingEntries.clear();
+
 	if (NeedsSort)
 	{
 		// Entries within a group are sorted by EntryType, in ascending order.
-		// Dat files follow this rule, zMaps inserted in the middle break it.
+		// Dat files follow this rule, zMaps inserted in the middle and deferred bitmaps break it.
+		// Stable sort keeps the order of same type entries, as used by field_nth.
 		NeedsSort = false;
-		std::sort(Entries.begin(), Entries.end(), [](const EntryData* lhs, const EntryData* rhs)
+		std::stable_sort(Entries.begin(), Entries.end(), [](const EntryData* lhs, const EntryData* rhs)
 		{
 			return lhs->EntryType < rhs->EntryType;
 		});
 		Entries.shrink_to_fit();
 	}
+
+	auto entryIndex = 0u;
+	for (auto type = 0; type <= FieldTypeCount; type++)
+	{
+		while (entryIndex < Entries.size() && static_cast<int>(Entries[entryIndex]->EntryType) < type)
+			entryIndex++;
+		FieldStart[type] = static_cast<uint16_t>(entryIndex);
+	}
+	FieldsIndexed = true;
+}
+
+EntryData* GroupData::FindEntry(FieldTypes entryType, int skipFirstN) const
+{
+	auto type = static_cast<int>(entryType);
+	if (FieldsIndexed)
+	{
+		if (type < 0 || type >= FieldTypeCount)
+			return nullptr;
+		auto index = FieldStart[type] + skipFirstN;
+		return index < FieldStart[type + 1] ? Entries[index] : nullptr;
+	}
+
+	// Groups that are still being built are scanned.
+	auto skipCount = 0;
+	for (const auto entry : Entries)
+	{
+		if (entry->EntryType > entryType)
+			break;
+		if (entry->EntryType == entryType)
+			if (skipCount++ == skipFirstN)
+				return entry;
+	}
+	return nullptr;
 }
 
 gdrv_bitmap8* GroupData::GetBitmap(int resolution) const
@@ -183,6 +260,10 @@ DatFile::~DatFile()
 		}
 		delete group;
 	}
+	for (auto block : FieldBlocks)
+		delete[] block;
+	delete Mapping;
+	delete CacheMapping;
 }
 
 char* DatFile::field(int groupIndex, FieldTypes targetEntryType)
@@ -190,17 +271,8 @@ char* DatFile::field(int groupIndex, FieldTypes targetEntryType)
 	assertm(targetEntryType != FieldTypes::Bitmap8bit && targetEntryType != FieldTypes::Bitmap16bit,
 	        "partman: Use specific get for bitmaps");
 
-	auto group = Groups[groupIndex];
-	for (const auto entry : group->GetEntries())
-	{
-		if (entry->EntryType == targetEntryType)
-		{
-			return entry->Buffer;
-		}
-		if (entry->EntryType > targetEntryType)
-			break;
-	}
-	return nullptr;
+	auto entry = Groups[groupIndex]->FindEntry(targetEntryType, 0);
+	return entry ? entry->Buffer : nullptr;
 }
 
 
@@ -209,32 +281,14 @@ char* DatFile::field_nth(int groupIndex, FieldTypes targetEntryType, int skipFir
 	assertm(targetEntryType != FieldTypes::Bitmap8bit && targetEntryType != FieldTypes::Bitmap16bit,
 	        "partman: Use specific get for bitmaps");
 
-	auto group = Groups[groupIndex];
-	auto skipCount = 0;
-	for (const auto entry : group->GetEntries())
-	{
-		if (entry->EntryType > targetEntryType)
-			break;
-		if (entry->EntryType == targetEntryType)
-			if (skipCount++ == skipFirstN)
-				return entry->Buffer;
-	}
-	return nullptr;
+	auto entry = Groups[groupIndex]->FindEntry(targetEntryType, skipFirstN);
+	return entry ? entry->Buffer : nullptr;
 }
 
 int DatFile::field_size_nth(int groupIndex, FieldTypes targetEntryType, int skipFirstN)
 {
-	auto group = Groups[groupIndex];
-	auto skipCount = 0;
-	for (const auto entry : group->GetEntries())
-	{
-		if (entry->EntryType > targetEntryType)
-			return 0;
-		if (entry->EntryType == targetEntryType)
-			if (skipCount++ == skipFirstN)
-				return entry->FieldSize;
-	}
-	return 0;
+	auto entry = Groups[groupIndex]->FindEntry(targetEntryType, skipFirstN);
+	return entry ? entry->FieldSize : 0;
 }
 
 int DatFile::field_size(int groupIndex, FieldTypes targetEntryType)
@@ -244,6 +298,14 @@ int DatFile::field_size(int groupIndex, FieldTypes targetEntryType)
 
 int DatFile::record_labeled(LPCSTR targetGroupName)
 {
+	LabelLookups++;
+	if (LabelsIndexed)
+	{
+		auto label = GroupLabels.find(targetGroupName);
+		return label != GroupLabels.end() ? label->second : -1;
+	}
+
+	// Finalize looks up labels before the index is built.
 	auto targetLength = strlen(targetGroupName);
 	for (int groupIndex = static_cast<int>(Groups.size()) - 1; groupIndex >= 0; --groupIndex)
 	{
@@ -280,6 +342,63 @@ zmap_header_type* DatFile::GetZMap(int groupIndex)
 	return group->GetZMap(fullscrn::GetResolution());
 }
 
+DatMemoryUsage DatFile::GetMemoryUsage() const
+{
+	DatMemoryUsage usage{};
+	for (const auto group : Groups)
+	{
+		for (const auto entry : group->GetEntries())
+		{
+			if (entry->EntryType == FieldTypes::Bitmap8bit)
+			{
+				auto bmp = reinterpret_cast<const gdrv_bitmap8*>(entry->Buffer);
+				usage.Bitmaps++;
+				if (bmp->IndexedBmpPtr && bmp->IndexedOwned)
+					usage.IndexedBytes += bmp->IndexedStride * bmp->Height;
+				if (bmp->BmpBufPtr1)
+					usage.PixelBytes += bmp->Stride * bmp->Height * sizeof(ColorRgba);
+				usage.SpanBytes += bmp->OpaqueSpanMemory();
+			}
+			else if (entry->EntryType == FieldTypes::Bitmap16bit)
+			{
+				auto zMap = reinterpret_cast<const zmap_header_type*>(entry->Buffer);
+				usage.ZMaps++;
+				usage.ZMapBytes += zMap->Stride * zMap->Height * sizeof(uint16_t);
+			}
+			else if (entry->FieldSize > 0)
+			{
+				usage.FieldBytes += entry->FieldSize;
+			}
+		}
+	}
+
+	for (const auto& deferred : DeferredEntries)
+		usage.DeferredBytes += deferred.FieldSize;
+	return usage;
+}
+
+char* DatFile::AllocateField(size_t size)
+{
+	// Fields are bump allocated from shared chunks, 8 byte aligned for the int/float arrays.
+	size = (size + 7) & ~static_cast<size_t>(7);
+	if (size > FieldChunkSize / 4)
+	{
+		auto block = new char[size];
+		FieldBlocks.push_back(block);
+		return block;
+	}
+
+	if (!FieldChunk || FieldChunkUsed + size > FieldChunkSize)
+	{
+		FieldChunk = new char[FieldChunkSize];
+		FieldBlocks.push_back(FieldChunk);
+		FieldChunkUsed = 0;
+	}
+	auto field = FieldChunk + FieldChunkUsed;
+	FieldChunkUsed += size;
+	return field;
+}
+
 void DatFile::Finalize()
 {
 	if (!pb::FullTiltMode)
@@ -310,10 +429,31 @@ void DatFile::Finalize()
 			Groups[i]->GetBitmap(0)->ScaleIndexed(0.84f, 0.84f);*/
 	}
 
-	for (auto group : Groups)
+	// Groups are independent, each one ends up the same no matter which thread finalized it.
+	WorkerPool pool(PostProcessThreads());
+	pool.ParallelFor(static_cast<int>(Groups.size()), [this](int index)
+	{
+		Groups[index]->FinalizeGroup();
+	});
+	BuildLabelIndex();
+}
+
+void DatFile::BuildLabelIndex()
+{
+	GroupLabels.clear();
+	GroupLabels.reserve(Groups.size());
+	for (auto groupIndex = 0; groupIndex < static_cast<int>(Groups.size()); groupIndex++)
 	{
-		group->FinalizeGroup();
+		auto groupName = field(groupIndex, FieldTypes::GroupName);
+		if (groupName)
+			GroupLabels[groupName] = groupIndex;
 	}
+	LabelsIndexed = true;
+}
+
+int DatFile::PostProcessThreads()
+{
+	return WorkerPool::DefaultThreadCount(4);
 }
 
 void DatFile::AddMsgFont(MsgFont* font, const std::string& fontName)
@@ -343,17 +483,23 @@ void DatFile::AddMsgFont(MsgFont* font, const std::string& fontName)
 			// First font group holds font name and gap width
 			auto groupName = new char[fontName.length() + 1];
 			strcpy(groupName, fontName.c_str());
-			group->AddEntry(new EntryData(FieldTypes::GroupName, groupName));
+			auto nameEntry = new EntryData(FieldTypes::GroupName, groupName);
+			nameEntry->FieldSize = static_cast<int>(fontName.length() + 1);
+			group->AddEntry(nameEntry);
 
 			auto gaps = new char[2];
 			*reinterpret_cast<int16_t*>(gaps) = font->GapWidth;
-			group->AddEntry(new EntryData(FieldTypes::ShortArray, gaps));
+			auto gapEntry = new EntryData(FieldTypes::ShortArray, gaps);
+			gapEntry->FieldSize = 2;
+			group->AddEntry(gapEntry);
 		}
 		else
 		{
 			auto groupName = new char[30];
 			sprintf(groupName, "char %d='%c'", charInd, charInd);
-			group->AddEntry(new EntryData(FieldTypes::GroupName, groupName));
+			auto nameEntry = new EntryData(FieldTypes::GroupName, groupName);
+			nameEntry->FieldSize = static_cast<int>(strlen(groupName) + 1);
+			group->AddEntry(nameEntry);
 		}
 
 		Groups.push_back(group);
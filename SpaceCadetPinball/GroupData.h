@@ -53,6 +53,32 @@ struct EntryData
 	FieldTypes EntryType{};
 	int FieldSize{};
 	char* Buffer{};
+	// Plain fields loaded from .dat live in DatFile field blocks.
+	bool OwnsBuffer = true;
+};
+
+
+// Bitmap or zMap of an inactive resolution, its payload stays in the .dat until needed.
+struct DeferredEntry
+{
+	int GroupIndex;
+	FieldTypes EntryType;
+	uint8_t Resolution;
+	long Offset;
+	size_t FieldSize;
+};
+
+
+struct DatMemoryUsage
+{
+	int Bitmaps;
+	int ZMaps;
+	size_t IndexedBytes;
+	size_t PixelBytes;
+	size_t SpanBytes;
+	size_t ZMapBytes;
+	size_t FieldBytes;
+	size_t DeferredBytes;
 };
 
 
@@ -84,7 +110,9 @@ public:
 
 	GroupData(int groupId);
 	void AddEntry(EntryData* entry);
+	void AddProcessedEntry(EntryData* entry);
 	void FinalizeGroup();
+	EntryData* FindEntry(FieldTypes entryType, int skipFirstN) const;
 	const std::vector<EntryData*>& GetEntries() const { return Entries; }
 	const EntryData* GetEntry(size_t index) const { return Entries[index]; }
 	size_t EntryCount() const { return Entries.size(); }
@@ -96,7 +124,13 @@ private:
 	std::vector<EntryData*> Entries;
 	gdrv_bitmap8* Bitmaps[3]{};
 	zmap_header_type* ZMaps[3]{};
+	// Spliced bitmaps and unflipped zMaps, processed by FinalizeGroup.
+	std::vector<EntryData*> PendingEntries;
 	bool NeedsSort = false;
+	// Entries of type T are [FieldStart[T], FieldStart[T + 1]), built by FinalizeGroup.
+	static const int FieldTypeCount = 14;
+	uint16_t FieldStart[FieldTypeCount + 1]{};
+	bool FieldsIndexed = false;
 
 	static void SplitSplicedBitmap(const gdrv_bitmap8& srcBmp, gdrv_bitmap8& bmp, zmap_header_type& zMap);
 
@@ -111,6 +145,16 @@ public:
 	std::string AppName;
 	std::string Description;
 	std::vector<GroupData*> Groups;
+	std::string FileName;
+	bool ResolutionLoaded[3]{};
+	std::vector<DeferredEntry> DeferredEntries;
+	// record_labeled calls, to relate table construction time to lookups.
+	int LabelLookups{};
+	// Keeps indexed bitmap views valid, null when the file could not be mapped.
+	class MappedFile* Mapping{};
+	// Set when groups came from DatCache, with palette already applied.
+	MappedFile* CacheMapping{};
+	bool FromCache{};
 
 	~DatFile();
 	char* field_nth(int groupIndex, FieldTypes targetEntryType, int skipFirstN);
@@ -121,8 +165,23 @@ public:
 	char* field_labeled(LPCSTR lpString, FieldTypes fieldType);
 	gdrv_bitmap8* GetBitmap(int groupIndex);
 	zmap_header_type* GetZMap(int groupIndex);
+	DatMemoryUsage GetMemoryUsage() const;
 	void Finalize();
+	char* AllocateField(size_t size);
+
+	// Workers for per-group post-processing: splitting, zMap flipping and palette application.
+	static int PostProcessThreads();
+	void BuildLabelIndex();
+	int FieldBlockCount() const { return static_cast<int>(FieldBlocks.size()); }
 
 private:
+	static const size_t FieldChunkSize = 64 * 1024;
+	std::vector<char*> FieldBlocks;
+	// Group name to index, last group wins like the backward scan it replaces.
+	std::unordered_map<std::string, int> GroupLabels;
+	bool LabelsIndexed = false;
+	char* FieldChunk{};
+	size_t FieldChunkUsed{};
+
 	void AddMsgFont(MsgFont* font, const std::string& fontName);
 };
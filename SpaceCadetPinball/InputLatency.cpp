@@ -0,0 +1,95 @@
+#include "pch.h"
+#include "InputLatency.h"
+
+bool InputLatency::Enabled = false;
+bool InputLatency::InFlight = false;
+int InputLatency::NextStage = 0;
+const void* InputLatency::Target = nullptr;
+double InputLatency::InputLagMs = 0;
+uint64_t InputLatency::StartCounter = 0;
+float InputLatency::StageLatency[static_cast<int>(LatencyStage::Count)]{};
+std::vector<float> InputLatency::Samples[static_cast<int>(LatencyStage::Count)];
+size_t InputLatency::SampleIndex = 0;
+
+
+void InputLatency::Clear()
+{
+	InFlight = false;
+	SampleIndex = 0;
+	for (auto& samples : Samples)
+		samples.clear();
+}
+
+LatencyStats InputLatency::GetStats(LatencyStage stage)
+{
+	LatencyStats stats{};
+	auto sorted = Samples[static_cast<int>(stage)];
+	if (sorted.empty())
+		return stats;
+
+	std::sort(sorted.begin(), sorted.end());
+	auto count = sorted.size();
+	stats.Min = sorted.front();
+	stats.Median = sorted[count / 2];
+	stats.P99 = sorted[std::min(count - 1, count * 99 / 100)];
+	stats.Samples = static_cast<int>(count);
+	return stats;
+}
+
+const char* InputLatency::StageName(LatencyStage stage)
+{
+	switch (stage)
+	{
+	case LatencyStage::InputDown:
+		return "pb::InputDown";
+	case LatencyStage::Dispatch:
+		return "Flipper message";
+	case LatencyStage::SpriteUpdate:
+		return "Flipper sprite";
+	case LatencyStage::RenderUpdate:
+		return "render::update";
+	case LatencyStage::Present:
+		return "Present";
+	default:
+		return "";
+	}
+}
+
+void InputLatency::BeginSample(Uint32 eventTimestamp)
+{
+	// Event timestamps use SDL_GetTicks, later stages use the performance counter.
+	InputLagMs = eventTimestamp ? static_cast<double>(SDL_GetTicks() - eventTimestamp) : 0.0;
+	StartCounter = SDL_GetPerformanceCounter();
+	Target = nullptr;
+	InFlight = true;
+	NextStage = 0;
+	MarkStage(LatencyStage::InputDown, nullptr, StartCounter);
+}
+
+void InputLatency::MarkStage(LatencyStage stage, const void* source, uint64_t counter)
+{
+	// Stages are recorded once, in order; a flipper press only counts for the flipper it was sent to.
+	if (static_cast<int>(stage) != NextStage)
+		return;
+	if (stage == LatencyStage::Dispatch)
+		Target = source;
+	else if (stage == LatencyStage::SpriteUpdate && source != Target)
+		return;
+
+	auto elapsed = counter - StartCounter;
+	StageLatency[NextStage] = static_cast<float>(
+		InputLagMs + static_cast<double>(elapsed) * 1000.0 / static_cast<double>(SDL_GetPerformanceFrequency()));
+	if (++NextStage < static_cast<int>(LatencyStage::Count))
+		return;
+
+	InFlight = false;
+	for (auto index = 0; index < static_cast<int>(LatencyStage::Count); index++)
+	{
+		auto& samples = Samples[index];
+		if (samples.size() < MaxSamples)
+			samples.push_back(StageLatency[index]);
+		else
+			samples[SampleIndex] = StageLatency[index];
+	}
+	SampleIndex = (SampleIndex + 1) % MaxSamples;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+enum class LatencyStage
+{
+	InputDown,
+	Dispatch,
+	SpriteUpdate,
+	RenderUpdate,
+	Present,
+	Count,
+};
+
+struct LatencyStats
+{
+	float Min;
+	float Median;
+	float P99;
+	int Samples;
+};
+
+// Tracks one flipper press at a time from its SDL event timestamp to the presented frame.
+class InputLatency
+{
+public:
+	static bool Enabled;
+
+	static void Begin(Uint32 eventTimestamp)
+	{
+		if (Enabled)
+			BeginSample(eventTimestamp);
+	}
+
+	static void Mark(LatencyStage stage, const void* source = nullptr, uint64_t counter = 0)
+	{
+		if (Enabled && InFlight)
+			MarkStage(stage, source, counter ? counter : SDL_GetPerformanceCounter());
+	}
+
+	static bool Pending(LatencyStage stage)
+	{
+		return Enabled && InFlight && NextStage == static_cast<int>(stage);
+	}
+
+	static void Clear();
+	static LatencyStats GetStats(LatencyStage stage);
+	static const char* StageName(LatencyStage stage);
+private:
+	static constexpr size_t MaxSamples = 256;
+	static bool InFlight;
+	static int NextStage;
+	static const void* Target;
+	static double InputLagMs;
+	static uint64_t StartCounter;
+	static float StageLatency[static_cast<int>(LatencyStage::Count)];
+	static std::vector<float> Samples[static_cast<int>(LatencyStage::Count)];
+	static size_t SampleIndex;
+
+	static void BeginSample(Uint32 eventTimestamp);
+	static void MarkStage(LatencyStage stage, const void* source, uint64_t counter);
+};
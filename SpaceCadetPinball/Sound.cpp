@@ -115,17 +115,16 @@ void Sound::PlaySound(Mix_Chunk* wavePtr, int time, TPinballComponent* soundSour
 	}
 }
 
-Mix_Chunk* Sound::LoadWaveFile(const std::string& lpName)
+Mix_Chunk* Sound::DecodeWaveFile(const std::string& lpName)
 {
 	if (!MixOpen)
 		return nullptr;
 
-	auto wavFile = fopenu(lpName.c_str(), "r");
-	if (!wavFile)
+	// Mix_LoadWAV_RW only reads the mixer spec, it does not touch playing channels.
+	auto rw = SDL_RWFromFile(lpName.c_str(), "rb");
+	if (!rw)
 		return nullptr;
-	fclose(wavFile);
-
-	return Mix_LoadWAV(lpName.c_str());
+	return Mix_LoadWAV_RW(rw, 1);
 }
 
 void Sound::FreeSound(Mix_Chunk* wave)
@@ -19,7 +19,8 @@ public:
 	static void Deactivate();
 	static void Close();
 	static void PlaySound(Mix_Chunk* wavePtr, int time, TPinballComponent *soundSource, const char* info);
-	static Mix_Chunk* LoadWaveFile(const std::string& lpName);
+	// Decodes a WAV converted to the mixer output format. Safe to call from worker threads.
+	static Mix_Chunk* DecodeWaveFile(const std::string& lpName);
 	static void FreeSound(Mix_Chunk* wave);
 	static void SetChannels(int channels);
 	static void SetVolume(int volume);
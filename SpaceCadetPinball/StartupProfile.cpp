@@ -0,0 +1,85 @@
+#include "pch.h"
+#include "StartupProfile.h"
+
+#include <cstdarg>
+
+bool StartupProfile::PrintEnabled = false;
+bool StartupProfile::Done = false;
+uint64_t StartupProfile::StartCounter = 0;
+double StartupProfile::TotalMs = 0;
+std::vector<StartupPhase> StartupProfile::Phases;
+std::vector<size_t> StartupProfile::OpenPhases;
+
+
+void StartupProfile::Start()
+{
+	StartCounter = SDL_GetPerformanceCounter();
+	Phases.reserve(24);
+}
+
+void StartupProfile::Begin(const char* name)
+{
+	if (Done)
+		return;
+
+	OpenPhases.push_back(Phases.size());
+	Phases.push_back({name, static_cast<int>(OpenPhases.size()) - 1, SDL_GetPerformanceCounter(), 0.0, {}});
+}
+
+void StartupProfile::End()
+{
+	if (Done || OpenPhases.empty())
+		return;
+
+	auto& phase = Phases[OpenPhases.back()];
+	phase.Milliseconds = ElapsedMs(phase.StartCounter);
+	OpenPhases.pop_back();
+}
+
+void StartupProfile::Detail(const char* format, ...)
+{
+	// Extra numbers for the innermost open phase, like sizes or counts.
+	if (Done || OpenPhases.empty())
+		return;
+
+	char buffer[256];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(buffer, sizeof buffer, format, args);
+	va_end(args);
+	Phases[OpenPhases.back()].Detail = buffer;
+}
+
+void StartupProfile::Finish()
+{
+	if (Done)
+		return;
+
+	// Phases left open by an early return are closed here.
+	while (!OpenPhases.empty())
+		End();
+	TotalMs = ElapsedMs(StartCounter);
+	Done = true;
+	if (!PrintEnabled)
+		return;
+
+	printf("First frame: %.2f ms after start\n", TotalMs);
+
+	// Nested phases are part of their parent, only top level phases add up to the total.
+	auto accounted = 0.0;
+	printf("Startup profile:\n");
+	for (const auto& phase : Phases)
+	{
+		printf("  %*s%-*s %8.2f ms  %s\n", phase.Depth * 2, "", 32 - phase.Depth * 2, phase.Name, phase.Milliseconds,
+		       phase.Detail.c_str());
+		if (phase.Depth == 0)
+			accounted += phase.Milliseconds;
+	}
+	printf("  %-32s %8.2f ms\n", "Other", TotalMs - accounted);
+}
+
+double StartupProfile::ElapsedMs(uint64_t since)
+{
+	return static_cast<double>(SDL_GetPerformanceCounter() - since) * 1000.0 /
+		static_cast<double>(SDL_GetPerformanceFrequency());
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+struct StartupPhase
+{
+	const char* Name;
+	int Depth;
+	uint64_t StartCounter;
+	double Milliseconds;
+	std::string Detail;
+};
+
+// Wall time of the startup phases from WinMain to the first presented frame.
+// Always recorded for the About dialog, -profile-startup also prints the breakdown.
+// Phases nest, only the first start is recorded, restarts are not.
+class StartupProfile
+{
+public:
+	static bool PrintEnabled;
+
+	static void Start();
+	static void Begin(const char* name);
+	static void End();
+	static void Detail(const char* format, ...);
+	static void Finish();
+
+	static bool Finished() { return Done; }
+	static double TotalMilliseconds() { return TotalMs; }
+	static const std::vector<StartupPhase>& GetPhases() { return Phases; }
+private:
+	static bool Done;
+	static uint64_t StartCounter;
+	static double TotalMs;
+	static std::vector<StartupPhase> Phases;
+	static std::vector<size_t> OpenPhases;
+
+	static double ElapsedMs(uint64_t since);
+};
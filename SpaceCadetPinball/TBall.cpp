@@ -2,6 +2,7 @@
 #include "TBall.h"
 
 
+#include "EventTrace.h"
 #include "fullscrn.h"
 #include "loader.h"
 #include "maths.h"
@@ -17,6 +18,7 @@ TBall::TBall(TPinballTable* table, int groupIndex) : TCollisionComponent(table,
 	visualStruct visual{};
 	char ballGroupName[10]{"ball"};
 
+	PublicMessageMask = PublicMessageBit(MessageCode::Reset);
 	RayMaxDistance = 0.0;
 	ActiveFlag = 1;
 	CollisionComp = nullptr;
@@ -120,6 +122,7 @@ bool TBall::already_hit(const TEdgeSegment& edge) const
 
 int TBall::Message(MessageCode code, float value)
 {
+	EventTrace::Scope trace(this, code, value);
 	if (code == MessageCode::Reset)
 	{
 		SpriteSetBall(-1, {0, 0}, 0.0f);
@@ -3,6 +3,7 @@
 
 
 #include "control.h"
+#include "EventTrace.h"
 #include "loader.h"
 #include "render.h"
 #include "timer.h"
@@ -11,6 +12,7 @@ TBlocker::TBlocker(TPinballTable* table, int groupIndex) : TCollisionComponent(t
 {
 	visualStruct visual{};
 
+	PublicMessageMask = PublicMessageBit(MessageCode::SetTiltLock) | PublicMessageBit(MessageCode::PlayerChanged) | PublicMessageBit(MessageCode::Reset);
 	loader::query_visual(groupIndex, 0, &visual);
 	SoundIndex4 = visual.SoundIndex4;
 	SoundIndex3 = visual.SoundIndex3;
@@ -25,6 +27,7 @@ TBlocker::TBlocker(TPinballTable* table, int groupIndex) : TCollisionComponent(t
 
 int TBlocker::Message(MessageCode code, float value)
 {
+	EventTrace::Scope trace(this, code, value);
 	switch (code)
 	{
 	case MessageCode::SetTiltLock:
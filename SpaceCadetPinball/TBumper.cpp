@@ -3,6 +3,7 @@
 
 
 #include "control.h"
+#include "EventTrace.h"
 #include "loader.h"
 #include "render.h"
 #include "timer.h"
@@ -12,6 +13,7 @@ TBumper::TBumper(TPinballTable* table, int groupIndex) : TCollisionComponent(tab
 {
 	visualStruct visual{};
 
+	PublicMessageMask = PublicMessageBit(MessageCode::PlayerChanged) | PublicMessageBit(MessageCode::Reset);
 	BmpIndex = 0;
 	Timer = 0;
 	TimerTime = *loader::query_float_attribute(groupIndex, 0, 407);
@@ -23,6 +25,7 @@ TBumper::TBumper(TPinballTable* table, int groupIndex) : TCollisionComponent(tab
 
 int TBumper::Message(MessageCode code, float value)
 {
+	EventTrace::Scope trace(this, code, value);
 	switch (code)
 	{
 	case MessageCode::TBumperSetBmpIndex:
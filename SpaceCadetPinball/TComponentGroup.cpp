@@ -3,6 +3,7 @@
 
 
 #include "control.h"
+#include "EventTrace.h"
 #include "loader.h"
 #include "timer.h"
 #include "TPinballTable.h"
@@ -10,6 +11,7 @@
 TComponentGroup::TComponentGroup(TPinballTable* table, int groupIndex) : TPinballComponent(table, groupIndex, false)
 {
 	Timer = 0;
+	PublicMessageMask = 0;
 	if (groupIndex > 0)
 	{
 		int attrCount;
@@ -19,9 +21,16 @@ TComponentGroup::TComponentGroup(TPinballTable* table, int groupIndex) : TPinbal
 		{
 			auto component = table->find_component(*shortArrPtr);
 			if (component)
+			{
 				List.push_back(component);
+				PublicMessageMask |= component->PublicMessageMask;
+			}
 		}
 	}
+	// Group only forwards the public codes that are not already broadcast by the table.
+	PublicMessageMask &= ~(PublicMessageBit(MessageCode::Pause) | PublicMessageBit(MessageCode::Resume) |
+		PublicMessageBit(MessageCode::LooseFocus) | PublicMessageBit(MessageCode::SetTiltLock) |
+		PublicMessageBit(MessageCode::PlayerChanged) | PublicMessageBit(MessageCode::GameOver));
 }
 
 TComponentGroup::~TComponentGroup()
@@ -35,6 +44,7 @@ TComponentGroup::~TComponentGroup()
 
 int TComponentGroup::Message(MessageCode code, float value)
 {
+	EventTrace::Scope trace(this, code, value);
 	if (code == MessageCode::TComponentGroupResetNotifyTimer)
 	{
 		if (this->Timer)
@@ -50,7 +60,8 @@ int TComponentGroup::Message(MessageCode code, float value)
 	{
 		for (auto component : List)
 		{
-			component->Message(code, value);
+			if (component->ReceivesMessage(code))
+				component->Message(code, value);
 		}
 	}
 	return 0;
@@ -2,6 +2,7 @@
 #include "TDemo.h"
 
 
+#include "EventTrace.h"
 #include "loader.h"
 #include "pb.h"
 #include "TEdgeSegment.h"
@@ -14,6 +15,7 @@ TDemo::TDemo(TPinballTable* table, int groupIndex)
 {
 	visualStruct visual{};
 
+	PublicMessageMask = PublicMessageBit(MessageCode::NewGame) | PublicMessageBit(MessageCode::GameOver) | PublicMessageBit(MessageCode::Reset);
 	RestartGameTimer = 0;
 	PlungerFlag = 0;
 	FlipLeftTimer = 0;
@@ -58,6 +60,7 @@ TDemo::TDemo(TPinballTable* table, int groupIndex)
 
 int TDemo::Message(MessageCode code, float value)
 {
+	EventTrace::Scope trace(this, code, value);
 	switch (code)
 	{
 	case MessageCode::NewGame:
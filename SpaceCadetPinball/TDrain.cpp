@@ -3,6 +3,7 @@
 
 
 #include "control.h"
+#include "EventTrace.h"
 #include "loader.h"
 #include "TBall.h"
 #include "timer.h"
@@ -10,12 +11,14 @@
 
 TDrain::TDrain(TPinballTable* table, int groupIndex) : TCollisionComponent(table, groupIndex, true)
 {
+	PublicMessageMask = PublicMessageBit(MessageCode::Reset);
 	Timer = 0;
 	TimerTime = *loader::query_float_attribute(groupIndex, 0, 407);
 }
 
 int TDrain::Message(MessageCode code, float value)
 {
+	EventTrace::Scope trace(this, code, value);
 	if (code == MessageCode::Reset)
 	{
 		if (Timer)
@@ -3,6 +3,7 @@
 
 
 #include "control.h"
+#include "EventTrace.h"
 #include "loader.h"
 #include "render.h"
 #include "TBall.h"
@@ -15,6 +16,7 @@ TFlagSpinner::TFlagSpinner(TPinballTable* table, int groupIndex) : TCollisionCom
 	visualStruct visual{};
 	vector2 end{}, start{};
 
+	PublicMessageMask = PublicMessageBit(MessageCode::Reset);
 	Timer = 0;
 	loader::query_visual(groupIndex, 0, &visual);
 	end.X = visual.FloatArr[0];
@@ -52,6 +54,7 @@ TFlagSpinner::TFlagSpinner(TPinballTable* table, int groupIndex) : TCollisionCom
 
 int TFlagSpinner::Message(MessageCode code, float value)
 {
+	EventTrace::Scope trace(this, code, value);
 	if (code == MessageCode::Reset)
 	{
 		if (Timer)
@@ -3,6 +3,8 @@
 
 
 #include "control.h"
+#include "EventTrace.h"
+#include "InputLatency.h"
 #include "loader.h"
 #include "pb.h"
 #include "render.h"
@@ -15,6 +17,7 @@ TFlipper::TFlipper(TPinballTable* table, int groupIndex) : TCollisionComponent(t
 {
 	visualStruct visual{};
 
+	PublicMessageMask = PublicMessageBit(MessageCode::Resume) | PublicMessageBit(MessageCode::LooseFocus) | PublicMessageBit(MessageCode::SetTiltLock) | PublicMessageBit(MessageCode::PlayerChanged) | PublicMessageBit(MessageCode::GameOver) | PublicMessageBit(MessageCode::Reset);
 	loader::query_visual(groupIndex, 0, &visual);
 	HardHitSoundId = visual.SoundIndex4;
 	SoftHitSoundId = visual.SoundIndex3;
@@ -62,6 +65,7 @@ TFlipper::~TFlipper()
 
 int TFlipper::Message(MessageCode code, float value)
 {
+	EventTrace::Scope trace(this, code, value);
 	switch (code)
 	{
 	case MessageCode::TFlipperExtend:
@@ -123,6 +127,7 @@ void TFlipper::UpdateSprite()
 
 	BmpIndex = newBmpIndex;
 	SpriteSet(BmpIndex);
+	InputLatency::Mark(LatencyStage::SpriteUpdate, this);
 }
 
 int TFlipper::GetFlipperStepAngle(float dt, float* dst) const
@@ -3,6 +3,7 @@
 
 
 #include "control.h"
+#include "EventTrace.h"
 #include "loader.h"
 #include "render.h"
 
@@ -20,6 +21,7 @@ TGate::TGate(TPinballTable* table, int groupIndex) : TCollisionComponent(table,
 
 int TGate::Message(MessageCode code, float value)
 {
+	EventTrace::Scope trace(this, code, value);
 	switch (code)
 	{
 	case MessageCode::TGateDisable:
@@ -3,6 +3,7 @@
 
 
 #include "control.h"
+#include "EventTrace.h"
 #include "loader.h"
 #include "pb.h"
 #include "TBall.h"
@@ -15,6 +16,7 @@ THole::THole(TPinballTable* table, int groupIndex) : TCollisionComponent(table,
 	visualStruct visual{};
 	circle_type circle{};
 
+	PublicMessageMask = PublicMessageBit(MessageCode::Reset);
 	Unknown4 = 0.050000001f;
 	MessageField = 0;
 	Timer = 0;
@@ -56,6 +58,7 @@ THole::THole(TPinballTable* table, int groupIndex) : TCollisionComponent(table,
 
 int THole::Message(MessageCode code, float value)
 {
+	EventTrace::Scope trace(this, code, value);
 	if (code == MessageCode::Reset && BallCapturedFlag)
 	{
 		if (Timer)
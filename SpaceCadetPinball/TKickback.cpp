@@ -3,6 +3,7 @@
 
 
 #include "control.h"
+#include "EventTrace.h"
 #include "loader.h"
 #include "maths.h"
 #include "render.h"
@@ -11,6 +12,7 @@
 
 TKickback::TKickback(TPinballTable* table, int groupIndex): TCollisionComponent(table, groupIndex, true)
 {
+	PublicMessageMask = PublicMessageBit(MessageCode::SetTiltLock) | PublicMessageBit(MessageCode::Reset);
 	MessageField = 0;
 	Timer = 0;
 	KickActiveFlag = 0;
@@ -21,6 +23,7 @@ TKickback::TKickback(TPinballTable* table, int groupIndex): TCollisionComponent(
 
 int TKickback::Message(MessageCode code, float value)
 {
+	EventTrace::Scope trace(this, code, value);
 	if ((code == MessageCode::SetTiltLock || code == MessageCode::Reset) && Timer)
 	{
 		timer::kill(Timer);
@@ -3,6 +3,7 @@
 
 
 #include "control.h"
+#include "EventTrace.h"
 #include "loader.h"
 #include "pb.h"
 #include "TBall.h"
@@ -17,6 +18,7 @@ TKickout::TKickout(TPinballTable* table, int groupIndex, bool someFlag): TCollis
 	visualStruct visual{};
 	circle_type circle{};
 
+	PublicMessageMask = PublicMessageBit(MessageCode::SetTiltLock) | PublicMessageBit(MessageCode::Reset);
 	NotSomeFlag = !someFlag;
 	if (!someFlag)
 		ActiveFlag = 0;
@@ -62,6 +64,7 @@ TKickout::TKickout(TPinballTable* table, int groupIndex, bool someFlag): TCollis
 
 int TKickout::Message(MessageCode code, float value)
 {
+	EventTrace::Scope trace(this, code, value);
 	switch (code)
 	{
 	case MessageCode::TKickoutRestartTimer:
@@ -3,6 +3,7 @@
 
 
 #include "control.h"
+#include "EventTrace.h"
 #include "loader.h"
 #include "render.h"
 #include "timer.h"
@@ -10,6 +11,7 @@
 
 TLight::TLight(TPinballTable* table, int groupIndex) : TPinballComponent(table, groupIndex, true)
 {
+	PublicMessageMask = PublicMessageBit(MessageCode::PlayerChanged) | PublicMessageBit(MessageCode::Reset);
 	TimeoutTimer = 0;
 	FlasherOnFlag = false;
 	UndoOverrideTimer = 0;
@@ -25,6 +27,7 @@ TLight::TLight(TPinballTable* table, int groupIndex) : TPinballComponent(table,
 
 int TLight::Message(MessageCode code, float value)
 {
+	EventTrace::Scope trace(this, code, value);
 	int bmpIndex;
 
 	switch (code)
@@ -3,6 +3,7 @@
 
 
 #include "control.h"
+#include "EventTrace.h"
 #include "loader.h"
 #include "timer.h"
 #include "TPinballTable.h"
@@ -10,6 +11,7 @@
 TLightBargraph::TLightBargraph(TPinballTable* table, int groupIndex) : TLightGroup(table, groupIndex)
 {
 	TimerTimeArray = nullptr;
+	PublicMessageMask |= PublicMessageBit(MessageCode::SetTiltLock);
 	TLightBargraph::Reset();
 	if (groupIndex > 0)
 	{
@@ -34,6 +36,7 @@ TLightBargraph::~TLightBargraph()
 
 int TLightBargraph::Message(MessageCode code, float value)
 {
+	EventTrace::Scope trace(this, code, value);
 	switch (code)
 	{
 	case MessageCode::TLightGroupGetOnCount:
@@ -3,6 +3,7 @@
 
 
 #include "control.h"
+#include "EventTrace.h"
 #include "loader.h"
 #include "timer.h"
 #include "TLight.h"
@@ -10,6 +11,8 @@
 
 TLightGroup::TLightGroup(TPinballTable* table, int groupIndex) : TPinballComponent(table, groupIndex, false)
 {
+	// Other public codes are forwarded to lights, which ignore them.
+	PublicMessageMask = PublicMessageBit(MessageCode::PlayerChanged) | PublicMessageBit(MessageCode::Reset);
 	Timer = 0;
 	NotifyTimer = 0;
 	TLightGroup::Reset();
@@ -30,6 +33,7 @@ TLightGroup::TLightGroup(TPinballTable* table, int groupIndex) : TPinballCompone
 
 int TLightGroup::Message(MessageCode code, float value)
 {
+	EventTrace::Scope trace(this, code, value);
 	auto const count = static_cast<int>(List.size());
 	switch (code)
 	{
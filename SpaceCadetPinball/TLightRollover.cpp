@@ -3,6 +3,7 @@
 
 
 #include "control.h"
+#include "EventTrace.h"
 #include "loader.h"
 #include "render.h"
 #include "TBall.h"
@@ -11,6 +12,7 @@
 
 TLightRollover::TLightRollover(TPinballTable* table, int groupIndex) : TRollover(table, groupIndex, false)
 {
+	PublicMessageMask = PublicMessageBit(MessageCode::Reset);
 	RolloverFlag = 0;
 	Timer = 0;
 	SpriteSet(-1);
@@ -20,6 +22,7 @@ TLightRollover::TLightRollover(TPinballTable* table, int groupIndex) : TRollover
 
 int TLightRollover::Message(MessageCode code, float value)
 {
+	EventTrace::Scope trace(this, code, value);
 	if (code == MessageCode::Reset)
 	{
 		ActiveFlag = 1;
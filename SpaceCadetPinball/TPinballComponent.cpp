@@ -2,6 +2,7 @@
 #include "TPinballComponent.h"
 
 #include "control.h"
+#include "EventTrace.h"
 #include "loader.h"
 #include "proj.h"
 #include "render.h"
@@ -13,6 +14,8 @@ TPinballComponent::TPinballComponent(TPinballTable* table, int groupIndex, bool
 	visualStruct visual{};
 
 	MessageField = 0;
+	// Base Message stores every code in MessageField, derived classes narrow this down.
+	PublicMessageMask = ~0u;
 	UnusedBaseFlag = 0;
 	ActiveFlag = 0;
 	PinballTable = table;
@@ -24,7 +27,10 @@ TPinballComponent::TPinballComponent(TPinballTable* table, int groupIndex, bool
 	VisualPosNormY = -1.0f;
 	GroupIndex = groupIndex;
 	if (table)
+	{
 		table->ComponentList.push_back(this);
+		table->MessageSubscribersDirty = true;
+	}
 	if (groupIndex >= 0)
 		GroupName = loader::query_name(groupIndex);
 
@@ -93,6 +99,7 @@ TPinballComponent::~TPinballComponent()
 		auto position = std::find(components.begin(), components.end(), this);
 		if (position != components.end())
 			components.erase(position);
+		PinballTable->MessageSubscribersDirty = true;
 	}
 
 	delete ListBitmap;
@@ -101,12 +108,19 @@ TPinballComponent::~TPinballComponent()
 
 int TPinballComponent::Message(MessageCode code, float value)
 {
+	EventTrace::Scope trace(this, code, value);
 	MessageField = static_cast<int>(code);
 	if (code == MessageCode::Reset)
 		MessageField = 0;
 	return 0;
 }
 
+bool TPinballComponent::ReceivesMessage(MessageCode code) const
+{
+	auto bit = PublicMessageBit(code);
+	return !bit || (PublicMessageMask & bit) != 0;
+}
+
 void TPinballComponent::port_draw()
 {
 }
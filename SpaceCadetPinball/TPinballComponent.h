@@ -131,6 +131,14 @@ enum class MessageCode
 	Reset = 1024,
 };
 
+// Public codes fit into a 32 bit mask, one bit per code.
+constexpr unsigned PublicMessageBit(MessageCode code)
+{
+	return code >= MessageCode::LeftFlipperInputPressed && code <= MessageCode::Reset
+		       ? 1u << (static_cast<int>(code) - static_cast<int>(MessageCode::LeftFlipperInputPressed))
+		       : 0u;
+}
+
 class TPinballComponent
 {
 public:
@@ -142,10 +150,13 @@ public:
 	virtual vector2 get_coordinates();
 	void SpriteSet(int index) const;
 	void SpriteSetBall(int index, vector2i pos, float depth) const;
+	bool ReceivesMessage(MessageCode code) const;
 
 	char UnusedBaseFlag;
 	char ActiveFlag;
 	int MessageField;
+	// Public codes this component reacts to, table and group broadcasts skip the rest.
+	unsigned PublicMessageMask;
 	char* GroupName;
 	component_control* Control;
 	int GroupIndex;
@@ -3,10 +3,13 @@
 
 
 #include "control.h"
+#include "EventTrace.h"
+#include "InputLatency.h"
 #include "loader.h"
 #include "midi.h"
 #include "pb.h"
 #include "render.h"
+#include "StartupProfile.h"
 #include "TBall.h"
 #include "TBlocker.h"
 #include "TBumper.h"
@@ -187,7 +190,9 @@ TPinballTable::TPinballTable(): TPinballComponent(nullptr, -1, false)
 	render::build_occlude_list();
 	pb::InfoTextBox = dynamic_cast<TTextBox*>(find_component("info_text_box"));
 	pb::MissTextBox = dynamic_cast<TTextBox*>(find_component("mission_text_box"));
+	StartupProfile::Begin("control::make_links");
 	control::make_links(this);
+	StartupProfile::End();
 }
 
 
@@ -296,10 +301,7 @@ void TPinballTable::tilt(float time)
 		loader::play_sound(SoundIndex3, nullptr, "TPinballTable1");
 		TiltTimeoutTimer = timer::set(30.0, this, tilt_timeout);
 
-		for (auto component : ComponentList)
-		{
-			component->Message(MessageCode::SetTiltLock, time);
-		}
+		BroadcastMessage(MessageCode::SetTiltLock, time);
 		LightGroup->Message(MessageCode::TLightTurnOffTimed, 0);
 		TiltLockFlag = 1;
 		control::table_control_handler(MessageCode::SetTiltLock);
@@ -317,6 +319,7 @@ void TPinballTable::port_draw()
 
 int TPinballTable::Message(MessageCode code, float value)
 {
+	EventTrace::Scope trace(this, code, value);
 	const char* rc_text;
 
 	switch (code)
@@ -324,6 +327,7 @@ int TPinballTable::Message(MessageCode code, float value)
 	case MessageCode::LeftFlipperInputPressed:
 		if (!TiltLockFlag)
 		{
+			InputLatency::Mark(LatencyStage::Dispatch, FlipperL);
 			FlipperL->Message(MessageCode::TFlipperExtend, value);
 		}
 		break;
@@ -336,6 +340,7 @@ int TPinballTable::Message(MessageCode code, float value)
 	case MessageCode::RightFlipperInputPressed:
 		if (!TiltLockFlag)
 		{
+			InputLatency::Mark(LatencyStage::Dispatch, FlipperR);
 			FlipperR->Message(MessageCode::TFlipperExtend, value);
 		}
 		break;
@@ -352,10 +357,7 @@ int TPinballTable::Message(MessageCode code, float value)
 	case MessageCode::Pause:
 	case MessageCode::Resume:
 	case MessageCode::LooseFocus:
-		for (auto component : ComponentList)
-		{
-			component->Message(code, value);
-		}
+		BroadcastMessage(code, value);
 		break;
 	case MessageCode::ClearTiltLock:
 		LightGroup->Message(MessageCode::TLightResetTimed, 0.0);
@@ -510,10 +512,7 @@ int TPinballTable::Message(MessageCode code, float value)
 			score::set(ScorePlayerNumber1, nextPlayer + 1);
 			score::update(ScorePlayerNumber1);
 
-			for (auto component : ComponentList)
-			{
-				component->Message(MessageCode::PlayerChanged, static_cast<float>(nextPlayer));
-			}
+			BroadcastMessage(MessageCode::PlayerChanged, static_cast<float>(nextPlayer));
 
 			const char* textboxText = nullptr;
 			switch (nextPlayer)
@@ -561,10 +560,7 @@ int TPinballTable::Message(MessageCode code, float value)
 		EndGameTimeoutTimer = timer::set(3.0, this, EndGame_timeout);
 		break;
 	case MessageCode::Reset:
-		for (auto component : ComponentList)
-		{
-			component->Message(MessageCode::Reset, 0);
-		}
+		BroadcastMessage(MessageCode::Reset, 0);
 		if (ReplayTimer)
 			timer::kill(ReplayTimer);
 		ReplayTimer = 0;
@@ -668,16 +664,43 @@ int TPinballTable::BallCountInRect(const vector2& pos, float margin)
 	return BallCountInRect(rect);
 }
 
+void TPinballTable::BroadcastMessage(MessageCode code, float value)
+{
+	auto bit = PublicMessageBit(code);
+	assertm(bit, "Only public codes can be broadcast");
+	if (MessageSubscribersDirty)
+		UpdateMessageSubscribers();
+
+	// Indexed loop, subscribers can be rebuilt by a nested broadcast.
+	auto& subscribers = MessageSubscribers[static_cast<int>(code) - static_cast<int>(MessageCode::LeftFlipperInputPressed)];
+	for (auto index = 0u; index < subscribers.size(); index++)
+	{
+		subscribers[index]->Message(code, value);
+	}
+}
+
+void TPinballTable::UpdateMessageSubscribers()
+{
+	MessageSubscribersDirty = false;
+	for (auto index = 0; index < 32; index++)
+	{
+		auto& subscribers = MessageSubscribers[index];
+		subscribers.clear();
+		for (auto component : ComponentList)
+		{
+			if (component->PublicMessageMask & (1u << index))
+				subscribers.push_back(component);
+		}
+	}
+}
+
 void TPinballTable::EndGame_timeout(int timerId, void* caller)
 {
 	auto table = static_cast<TPinballTable*>(caller);
 	table->EndGameTimeoutTimer = 0;
 	pb::end_game();
 
-	for (auto component : table->ComponentList)
-	{
-		component->Message(MessageCode::GameOver, 0);
-	}
+	table->BroadcastMessage(MessageCode::GameOver, 0);
 	if (table->Demo)
 		table->Demo->Message(MessageCode::GameOver, 0.0);
 	control::handler(MessageCode::ControlMissionStarted, pb::MissTextBox);
@@ -38,6 +38,7 @@ public:
 	TBall* AddBall(vector2 position);
 	int BallCountInRect(const RectF& rect);
 	int BallCountInRect(const vector2& pos, float margin);
+	void BroadcastMessage(MessageCode code, float value);
 
 	static void EndGame_timeout(int timerId, void* caller);
 	static void LightShow_timeout(int timerId, void* caller);
@@ -98,7 +99,13 @@ public:
 	int UnknownP81{};
 	int UnknownP82{};
 	int TiltLockFlag;
+	bool MessageSubscribersDirty{true};
 
 private:
 	static int score_multipliers[5];
+
+	// Per public code subscribers, in ComponentList order.
+	std::vector<TPinballComponent*> MessageSubscribers[32];
+
+	void UpdateMessageSubscribers();
 };
@@ -3,6 +3,7 @@
 
 
 #include "control.h"
+#include "EventTrace.h"
 #include "loader.h"
 #include "maths.h"
 #include "pb.h"
@@ -63,6 +64,7 @@ void TPlunger::Collision(TBall* ball, vector2* nextPosition, vector2* direction,
 
 int TPlunger::Message(MessageCode code, float value)
 {
+	EventTrace::Scope trace(this, code, value);
 	switch (code)
 	{
 	case MessageCode::PlungerInputPressed:
@@ -3,6 +3,7 @@
 
 
 #include "control.h"
+#include "EventTrace.h"
 #include "gdrv.h"
 #include "loader.h"
 #include "render.h"
@@ -14,11 +15,13 @@
 TRollover::TRollover(TPinballTable* table, int groupIndex, bool createWall) : TCollisionComponent(
 	table, groupIndex, createWall)
 {
+	PublicMessageMask = PublicMessageBit(MessageCode::Reset);
 }
 
 
 TRollover::TRollover(TPinballTable* table, int groupIndex) : TCollisionComponent(table, groupIndex, false)
 {
+	PublicMessageMask = PublicMessageBit(MessageCode::Reset);
 	SpriteSet(0);
 	build_walls(groupIndex);
 }
@@ -26,6 +29,7 @@ TRollover::TRollover(TPinballTable* table, int groupIndex) : TCollisionComponent
 
 int TRollover::Message(MessageCode code, float value)
 {
+	EventTrace::Scope trace(this, code, value);
 	if (code == MessageCode::Reset)
 	{
 		ActiveFlag = 1;
@@ -3,6 +3,7 @@
 
 
 #include "control.h"
+#include "EventTrace.h"
 #include "loader.h"
 #include "render.h"
 #include "TPinballTable.h"
@@ -14,6 +15,7 @@ TSink::TSink(TPinballTable* table, int groupIndex) : TCollisionComponent(table,
 {
 	visualStruct visual{};
 
+	PublicMessageMask = PublicMessageBit(MessageCode::PlayerChanged) | PublicMessageBit(MessageCode::Reset);
 	MessageField = 0;
 	loader::query_visual(groupIndex, 0, &visual);
 	BallThrowDirection = visual.Kicker.ThrowBallDirection;
@@ -30,6 +32,7 @@ TSink::TSink(TPinballTable* table, int groupIndex) : TCollisionComponent(table,
 
 int TSink::Message(MessageCode code, float value)
 {
+	EventTrace::Scope trace(this, code, value);
 	switch (code)
 	{
 	case MessageCode::TSinkResetTimer:
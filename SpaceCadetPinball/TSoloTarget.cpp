@@ -3,6 +3,7 @@
 
 
 #include "control.h"
+#include "EventTrace.h"
 #include "loader.h"
 #include "render.h"
 #include "timer.h"
@@ -12,6 +13,7 @@ TSoloTarget::TSoloTarget(TPinballTable* table, int groupIndex) : TCollisionCompo
 {
 	visualStruct visual{};
 
+	PublicMessageMask = PublicMessageBit(MessageCode::Reset);
 	Timer = 0;
 	TimerTime = 0.1f;
 	loader::query_visual(groupIndex, 0, &visual);
@@ -21,6 +23,7 @@ TSoloTarget::TSoloTarget(TPinballTable* table, int groupIndex) : TCollisionCompo
 
 int TSoloTarget::Message(MessageCode code, float value)
 {
+	EventTrace::Scope trace(this, code, value);
 	switch (code)
 	{
 	case MessageCode::TSoloTargetDisable:
@@ -2,6 +2,7 @@
 #include "TTextBox.h"
 
 #include "control.h"
+#include "EventTrace.h"
 #include "fullscrn.h"
 #include "loader.h"
 #include "pb.h"
@@ -12,6 +13,7 @@
 
 TTextBox::TTextBox(TPinballTable* table, int groupIndex) : TPinballComponent(table, groupIndex, true)
 {
+	PublicMessageMask = 0;
 	OffsetX = 0;
 	OffsetY = 0;
 	Width = 0;
@@ -53,6 +55,7 @@ TTextBox::~TTextBox()
 
 int TTextBox::Message(MessageCode code, float value)
 {
+	EventTrace::Scope trace(this, code, value);
 	return 0;
 }
 
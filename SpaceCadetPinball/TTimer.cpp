@@ -2,15 +2,18 @@
 #include "TTimer.h"
 
 #include "control.h"
+#include "EventTrace.h"
 #include "timer.h"
 
 TTimer::TTimer(TPinballTable* table, int groupIndex) : TPinballComponent(table, groupIndex, true)
 {
+	PublicMessageMask = PublicMessageBit(MessageCode::SetTiltLock) | PublicMessageBit(MessageCode::GameOver) | PublicMessageBit(MessageCode::Reset);
 	Timer = 0;
 }
 
 int TTimer::Message(MessageCode code, float value)
 {
+	EventTrace::Scope trace(this, code, value);
 	switch (code)
 	{
 	case MessageCode::TTimerResetTimer:
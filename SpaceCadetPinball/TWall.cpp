@@ -3,17 +3,20 @@
 
 
 #include "control.h"
+#include "EventTrace.h"
 #include "render.h"
 #include "timer.h"
 
 TWall::TWall(TPinballTable* table, int groupIndex) : TCollisionComponent(table, groupIndex, true)
 {
+	PublicMessageMask = PublicMessageBit(MessageCode::Reset);
 	if (RenderSprite)
 		SpriteSet(-1);
 }
 
 int TWall::Message(MessageCode code, float value)
 {
+	EventTrace::Scope trace(this, code, value);
 	if (code == MessageCode::Reset && Timer)
 	{
 		timer::kill(Timer);
@@ -0,0 +1,123 @@
+#include "pch.h"
+#include "WorkerPool.h"
+
+
+WorkerPool::WorkerPool(int threadCount)
+{
+	for (auto index = 0; index < threadCount; index++)
+		Threads.emplace_back(&WorkerPool::WorkerMain, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Quit = true;
+	}
+	WorkReady.notify_all();
+	for (auto& thread : Threads)
+		thread.join();
+}
+
+void WorkerPool::ParallelFor(int count, const std::function<void(int)>& func)
+{
+	if (count <= 0)
+		return;
+	if (Threads.empty() || count == 1)
+	{
+		for (auto index = 0; index < count; index++)
+			func(index);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Func = &func;
+		Count = count;
+		NextIndex = 0;
+		ActiveWorkers = static_cast<int>(Threads.size());
+		Generation++;
+	}
+	WorkReady.notify_all();
+
+	RunItems();
+
+	// Workers can still be inside func even after all indices were handed out.
+	std::unique_lock<std::mutex> lock(Mutex);
+	WorkDone.wait(lock, [this] { return ActiveWorkers == 0; });
+	Func = nullptr;
+}
+
+void WorkerPool::Submit(std::function<void()> func)
+{
+	if (Threads.empty())
+	{
+		func();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Tasks.push_back(std::move(func));
+		PendingTasks++;
+	}
+	WorkReady.notify_one();
+}
+
+void WorkerPool::Wait()
+{
+	std::unique_lock<std::mutex> lock(Mutex);
+	TasksDone.wait(lock, [this] { return PendingTasks == 0; });
+}
+
+int WorkerPool::DefaultThreadCount(int maxThreads)
+{
+	return Clamp(SDL_GetCPUCount() - 1, 0, maxThreads);
+}
+
+void WorkerPool::WorkerMain()
+{
+	unsigned seenGeneration = 0;
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(Mutex);
+			WorkReady.wait(lock, [&] { return Quit || Generation != seenGeneration || !Tasks.empty(); });
+			if (Generation != seenGeneration)
+			{
+				seenGeneration = Generation;
+			}
+			else if (!Tasks.empty())
+			{
+				task = std::move(Tasks.front());
+				Tasks.pop_front();
+			}
+			else
+			{
+				return;
+			}
+		}
+
+		if (task)
+		{
+			task();
+			std::lock_guard<std::mutex> lock(Mutex);
+			if (--PendingTasks == 0)
+				TasksDone.notify_all();
+			continue;
+		}
+
+		RunItems();
+
+		std::lock_guard<std::mutex> lock(Mutex);
+		if (--ActiveWorkers == 0)
+			WorkDone.notify_one();
+	}
+}
+
+void WorkerPool::RunItems()
+{
+	for (auto index = NextIndex++; index < Count; index = NextIndex++)
+		(*Func)(index);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+// Fixed set of threads that split index ranges with the calling thread or run queued tasks.
+class WorkerPool
+{
+public:
+	explicit WorkerPool(int threadCount);
+	~WorkerPool();
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	int ThreadCount() const { return static_cast<int>(Threads.size()); }
+
+	// Calls func(index) for every index in [0, count), returns when all calls are done.
+	void ParallelFor(int count, const std::function<void(int)>& func);
+
+	// Queues func to run on a worker, runs it inline when the pool has no threads.
+	// Tasks must not call ParallelFor on the pool they are running on.
+	void Submit(std::function<void()> func);
+
+	// Returns when all submitted tasks are done.
+	void Wait();
+
+	// Worker count for an N-way split that leaves one core for the main thread.
+	static int DefaultThreadCount(int maxThreads);
+private:
+	std::vector<std::thread> Threads;
+	std::mutex Mutex;
+	std::condition_variable WorkReady, WorkDone, TasksDone;
+	std::deque<std::function<void()>> Tasks;
+	int PendingTasks = 0;
+	const std::function<void(int)>* Func = nullptr;
+	std::atomic<int> NextIndex{0};
+	int Count = 0, ActiveWorkers = 0;
+	unsigned Generation = 0;
+	bool Quit = false;
+
+	void WorkerMain();
+	void RunItems();
+};
@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "control.h"
 
+#include "EventTrace.h"
 #include "midi.h"
 #include "pb.h"
 #include "TBall.h"
@@ -891,6 +892,7 @@ TPinballComponent* control::make_component_link(component_tag_base& tag)
 
 void control::handler(MessageCode code, TPinballComponent* cmp)
 {
+	EventTrace::Scope trace(TraceEventType::ControlHandler, cmp->GroupName, static_cast<int>(code), 0.0f);
 	component_control* control = cmp->Control;
 	
 	if (control)
@@ -3,6 +3,7 @@
 
 
 #include "options.h"
+#include "partman.h"
 #include "pb.h"
 #include "render.h"
 #include "winmain.h"
@@ -98,6 +99,11 @@ void fullscrn::SetResolution(int value)
 	if (!pb::FullTiltMode || pb::FullTiltDemoMode)
 		value = 0;
 	assertm(value >= 0 && value <= 2, "Resolution value out of bounds");
+
+	// Only the active resolution is read at startup, other sets are loaded on first use.
+	// The current resolution is kept when they can not be read.
+	if (pb::record_table && !partman::load_resolution(pb::record_table, value))
+		return;
 	resolution = value;
 }
 
@@ -108,6 +114,7 @@ int fullscrn::GetMaxResolution()
 
 void fullscrn::window_size_changed()
 {
+	winmain::RedrawPending = true;
 	int width, height;
 	SDL_GetRendererOutputSize(winmain::Renderer, &width, &height);
 	int menuHeight = options::Options.ShowMenu ? winmain::MainMenuHeight : 0;
@@ -2,10 +2,13 @@
 #include "gdrv.h"
 
 #include "GroupData.h"
+#include "options.h"
 #include "partman.h"
 #include "pb.h"
 #include "score.h"
+#include "simd.h"
 #include "winmain.h"
+#include "WorkerPool.h"
 #include "TTextBox.h"
 #include "fullscrn.h"
 
@@ -30,10 +33,12 @@ gdrv_bitmap8::gdrv_bitmap8(int width, int height, bool indexed, bool bmpBuff)
 	BitmapType = BitmapTypes::DibBitmap;
 	Texture = nullptr;
 	IndexedBmpPtr = nullptr;
+	IndexedOwned = true;
 	BmpBufPtr1 = nullptr;
 	XPosition = 0;
 	YPosition = 0;
 	Resolution = 0;
+	TrackDirty = false;
 
 	if (indexed)
 		IndexedBmpPtr = new char[Height * IndexedStride];
@@ -41,7 +46,7 @@ gdrv_bitmap8::gdrv_bitmap8(int width, int height, bool indexed, bool bmpBuff)
 		BmpBufPtr1 = new ColorRgba[Height * Stride];
 }
 
-gdrv_bitmap8::gdrv_bitmap8(const dat8BitBmpHeader& header)
+gdrv_bitmap8::gdrv_bitmap8(const dat8BitBmpHeader& header, char* indexedView)
 {
 	assertm(header.Width >= 0 && header.Height >= 0, "Negative bitmap8 dimensions");
 
@@ -60,6 +65,7 @@ gdrv_bitmap8::gdrv_bitmap8(const dat8BitBmpHeader& header)
 	YPosition = header.YPosition;
 	Resolution = header.Resolution;
 	Texture = nullptr;
+	TrackDirty = false;
 
 	int sizeInBytes;
 	if (BitmapType == BitmapTypes::Spliced)
@@ -76,7 +82,8 @@ gdrv_bitmap8::gdrv_bitmap8(const dat8BitBmpHeader& header)
 		assertm(sizeInBytes == header.Size, "Wrong bitmap8 size");
 	}
 
-	IndexedBmpPtr = new char[sizeInBytes];
+	IndexedOwned = indexedView == nullptr;
+	IndexedBmpPtr = IndexedOwned ? new char[sizeInBytes] : indexedView;
 	BmpBufPtr1 = new ColorRgba[Stride * Height];
 }
 
@@ -85,7 +92,8 @@ gdrv_bitmap8::~gdrv_bitmap8()
 	if (BitmapType != BitmapTypes::None)
 	{
 		delete[] BmpBufPtr1;
-		delete[] IndexedBmpPtr;
+		if (IndexedOwned)
+			delete[] IndexedBmpPtr;
 		if (Texture)
 			SDL_DestroyTexture(Texture);
 	}
@@ -117,9 +125,11 @@ void gdrv_bitmap8::ScaleIndexed(float scaleX, float scaleY)
 	Stride = IndexedStride = Width = newWidht;
 	Height = newHeight;
 
-	delete IndexedBmpPtr;
+	if (IndexedOwned)
+		delete[] IndexedBmpPtr;
 	IndexedBmpPtr = newIndBuf;
-	delete BmpBufPtr1;
+	IndexedOwned = true;
+	delete[] BmpBufPtr1;
 	BmpBufPtr1 = new ColorRgba[Stride * Height];
 }
 
@@ -139,29 +149,110 @@ void gdrv_bitmap8::CreateTexture(const char* scaleHint, int access)
 		Width, Height
 	);
 	SDL_SetTextureBlendMode(Texture, SDL_BLENDMODE_NONE);
+
+	// New texture has undefined content, upload everything on the next blit.
+	TrackDirty = access == SDL_TEXTUREACCESS_STREAMING;
+	DirtyRects.clear();
+	MarkDirty(0, 0, Width, Height);
 }
 
-void gdrv_bitmap8::BlitToTexture()
+size_t gdrv_bitmap8::BlitToTexture()
 {
 	assertm(Texture, "Updating null texture");
-	int pitch = 0;
-	ColorRgba* lockedPixels;
-	auto result = SDL_LockTexture
-	(
-		Texture,
-		nullptr,
-		reinterpret_cast<void**>(&lockedPixels),
-		&pitch
-	);
-	assertm(result == 0, "Updating non-streaming texture");
-	assertm(static_cast<unsigned>(pitch) == Width * sizeof(ColorRgba), "Padding on vScreen texture");
+	assertm(TrackDirty, "Updating non-streaming texture");
+
+	size_t uploaded = 0;
+	for (const auto& rect : DirtyRects)
+	{
+		SDL_UpdateTexture(Texture, &rect, &BmpBufPtr1[rect.y * Stride + rect.x],
+		                  static_cast<int>(Stride * sizeof(ColorRgba)));
+		uploaded += rect.w * rect.h * sizeof(ColorRgba);
+	}
+	DirtyRects.clear();
+	return uploaded;
+}
+
+void gdrv_bitmap8::BuildOpaqueSpans()
+{
+	OpaqueSpans.clear();
+	RowSpans.clear();
+	if (!BmpBufPtr1)
+		return;
+
+	RowSpans.reserve(Height + 1);
+	for (auto y = 0; y < Height; y++)
+	{
+		RowSpans.push_back(static_cast<int>(OpaqueSpans.size()));
+		auto row = &BmpBufPtr1[y * Stride];
+		for (auto x = 0; x < Width;)
+		{
+			if (!row[x].Color)
+			{
+				x++;
+				continue;
+			}
+
+			auto start = x;
+			while (x < Width && row[x].Color)
+				x++;
+			OpaqueSpans.push_back(gdrv_span{static_cast<uint16_t>(start), static_cast<uint16_t>(x - start)});
+		}
+	}
+	RowSpans.push_back(static_cast<int>(OpaqueSpans.size()));
+	OpaqueSpans.shrink_to_fit();
+}
+
+size_t gdrv_bitmap8::OpaqueSpanMemory() const
+{
+	return OpaqueSpans.capacity() * sizeof(gdrv_span) + RowSpans.capacity() * sizeof(int);
+}
+
+void gdrv_bitmap8::MarkDirty(int xOff, int yOff, int width, int height)
+{
+	if (!TrackDirty)
+		return;
 
-	std::memcpy(lockedPixels, BmpBufPtr1, Width * Height * sizeof(ColorRgba));
+	SDL_Rect rect{xOff, yOff, width, height}, bounds{0, 0, Width, Height};
+	if (!SDL_IntersectRect(&rect, &bounds, &rect))
+		return;
+
+	while (true)
+	{
+		// Fold overlapping regions into the new one, until it is disjoint from the rest.
+		auto overlap = std::find_if(DirtyRects.begin(), DirtyRects.end(), [&rect](const SDL_Rect& dirty)
+		{
+			return SDL_HasIntersection(&rect, &dirty);
+		});
+		if (overlap != DirtyRects.end())
+		{
+			SDL_UnionRect(&rect, &*overlap, &rect);
+			DirtyRects.erase(overlap);
+			continue;
+		}
+		if (DirtyRects.size() < MaxDirtyRects)
+			break;
 
-	SDL_UnlockTexture(Texture);
+		// List is full, merge with the region that grows the least.
+		auto best = DirtyRects.begin();
+		auto bestGrowth = INT_MAX;
+		for (auto it = DirtyRects.begin(); it != DirtyRects.end(); ++it)
+		{
+			SDL_Rect merged;
+			SDL_UnionRect(&rect, &*it, &merged);
+			auto growth = merged.w * merged.h - it->w * it->h;
+			if (growth < bestGrowth)
+			{
+				bestGrowth = growth;
+				best = it;
+			}
+		}
+		SDL_UnionRect(&rect, &*best, &rect);
+		DirtyRects.erase(best);
+	}
+	DirtyRects.push_back(rect);
 }
 
-int gdrv::display_palette(ColorRgba* plt)
+int gdrv::display_palette(ColorRgba* plt, bool applyToBitmaps)
 {
 	// Colors from Windows system palette
 	const ColorRgba sysPaletteColors[10]
@@ -191,16 +282,23 @@ int gdrv::display_palette(ColorRgba* plt)
 
 	current_palette[255] = ColorRgba::White();
 
-	for (const auto group : pb::record_table->Groups)
+	// Bitmaps loaded from DatCache already have this palette applied.
+	if (applyToBitmaps)
 	{
-		for (int i = 0; i <= 2; i++)
+		// Every bitmap is converted on its own, groups are split between workers.
+		const auto& groups = pb::record_table->Groups;
+		WorkerPool pool(DatFile::PostProcessThreads());
+		pool.ParallelFor(static_cast<int>(groups.size()), [&groups](int index)
 		{
-			auto bmp = group->GetBitmap(i);
-			if (bmp)
+			for (int i = 0; i <= 2; i++)
 			{
-				ApplyPalette(*bmp);
+				auto bmp = groups[index]->GetBitmap(i);
+				if (bmp && bmp->IndexedBmpPtr)
+				{
+					ApplyPalette(*bmp);
+				}
 			}
-		}
+		});
 	}
 
 	return 0;
@@ -213,18 +311,20 @@ void gdrv::fill_bitmap(gdrv_bitmap8* bmp, int width, int height, int xOff, int y
 
 void gdrv::fill_bitmap(gdrv_bitmap8* bmp, int width, int height, int xOff, int yOff, ColorRgba fillColor)
 {
+	bmp->MarkDirty(xOff, yOff, width, height);
 	auto bmpPtr = &bmp->BmpBufPtr1[bmp->Width * yOff + xOff];
+	auto fillRow = Kernels(simd::Level).Fill;
 	for (; height > 0; --height)
 	{
-		for (int x = width; x > 0; --x)
-			*bmpPtr++ = fillColor;
-		bmpPtr += bmp->Stride - width;
+		fillRow(width, bmpPtr, fillColor);
+		bmpPtr += bmp->Stride;
 	}
 }
 
 void gdrv::copy_bitmap(gdrv_bitmap8* dstBmp, int width, int height, int xOff, int yOff, gdrv_bitmap8* srcBmp,
                        int srcXOff, int srcYOff)
 {
+	dstBmp->MarkDirty(xOff, yOff, width, height);
 	auto srcPtr = &srcBmp->BmpBufPtr1[srcBmp->Stride * srcYOff + srcXOff];
 	auto dstPtr = &dstBmp->BmpBufPtr1[dstBmp->Stride * yOff + xOff];
 
@@ -239,26 +339,45 @@ void gdrv::copy_bitmap(gdrv_bitmap8* dstBmp, int width, int height, int xOff, in
 void gdrv::copy_bitmap_w_transparency(gdrv_bitmap8* dstBmp, int width, int height, int xOff, int yOff,
                                       gdrv_bitmap8* srcBmp, int srcXOff, int srcYOff)
 {
+	dstBmp->MarkDirty(xOff, yOff, width, height);
 	auto srcPtr = &srcBmp->BmpBufPtr1[srcBmp->Stride * srcYOff + srcXOff];
 	auto dstPtr = &dstBmp->BmpBufPtr1[dstBmp->Stride * yOff + xOff];
 
-	for (int y = height; y > 0; --y)
+	if (!srcBmp->RowSpans.empty())
 	{
-		for (int x = width; x > 0; --x)
+		// Opaque runs are copied as is, transparent ones are skipped without being read.
+		auto srcEnd = srcXOff + width;
+		for (int y = srcYOff; y < srcYOff + height; ++y)
 		{
-			if ((*srcPtr).Color)
-				*dstPtr = *srcPtr;
-			++srcPtr;
-			++dstPtr;
+			for (auto index = srcBmp->RowSpans[y]; index < srcBmp->RowSpans[y + 1]; index++)
+			{
+				const auto& span = srcBmp->OpaqueSpans[index];
+				if (span.Start >= srcEnd)
+					break;
+
+				auto start = std::max(static_cast<int>(span.Start), srcXOff);
+				auto end = std::min(span.Start + span.Length, srcEnd);
+				if (start < end)
+					std::memcpy(dstPtr + start - srcXOff, srcPtr + start - srcXOff, (end - start) * sizeof(ColorRgba));
+			}
+			srcPtr += srcBmp->Stride;
+			dstPtr += dstBmp->Stride;
 		}
+		return;
+	}
 
-		srcPtr += srcBmp->Stride - width;
-		dstPtr += dstBmp->Stride - width;
+	auto copyRow = Kernels(simd::Level).CopyTransparent;
+	for (int y = height; y > 0; --y)
+	{
+		copyRow(width, dstPtr, srcPtr);
+		srcPtr += srcBmp->Stride;
+		dstPtr += dstBmp->Stride;
 	}
 }
 
 void gdrv::ScrollBitmapHorizontal(gdrv_bitmap8* bmp, int xStart)
 {
+	bmp->MarkDirty(0, 0, bmp->Width, bmp->Height);
 	auto srcPtr = bmp->BmpBufPtr1;
 	auto startOffset = xStart >= 0 ? 0 : -xStart;
 	auto endOffset = xStart >= 0 ? xStart : 0;
@@ -299,6 +418,15 @@ void gdrv::ApplyPalette(gdrv_bitmap8& bmp)
 			*dst++ = current_palette[*src++];
 		}
 	}
+	bmp.BuildOpaqueSpans();
+
+	// Palette is set once per table load, after that the indexed copy is only dead weight.
+	if (options::Options.PaletteBakedBitmaps)
+	{
+		if (bmp.IndexedOwned)
+			delete[] bmp.IndexedBmpPtr;
+		bmp.IndexedBmpPtr = nullptr;
+	}
 }
 
 void gdrv::CreatePreview(gdrv_bitmap8& bmp)
@@ -309,3 +437,135 @@ void gdrv::CreatePreview(gdrv_bitmap8& bmp)
 	bmp.CreateTexture("nearest", SDL_TEXTUREACCESS_STATIC);
 	SDL_UpdateTexture(bmp.Texture, nullptr, bmp.BmpBufPtr1, bmp.Width * 4);
 }
+
+const gdrv_row_kernels& gdrv::Kernels(SimdLevel level)
+{
+	static const gdrv_row_kernels scalar{copy_transparent_row, fill_row};
+#ifdef SIMD_SSE2
+	static const gdrv_row_kernels sse2{copy_transparent_row_sse2, fill_row_sse2};
+#endif
+#ifdef SIMD_AVX2
+	static const gdrv_row_kernels avx2{copy_transparent_row_avx2, fill_row_avx2};
+#endif
+#ifdef SIMD_NEON
+	static const gdrv_row_kernels neon{copy_transparent_row_neon, fill_row_neon};
+#endif
+
+	switch (level)
+	{
+#ifdef SIMD_SSE2
+	case SimdLevel::Sse2:
+		return sse2;
+#endif
+#ifdef SIMD_AVX2
+	case SimdLevel::Avx2:
+		return avx2;
+#endif
+#ifdef SIMD_NEON
+	case SimdLevel::Neon:
+		return neon;
+#endif
+	default:
+		return scalar;
+	}
+}
+
+void gdrv::copy_transparent_row(int width, ColorRgba* dstPtr, const ColorRgba* srcPtr)
+{
+	for (int x = 0; x < width; x++)
+	{
+		if (srcPtr[x].Color)
+			dstPtr[x] = srcPtr[x];
+	}
+}
+
+void gdrv::fill_row(int width, ColorRgba* dstPtr, ColorRgba fillColor)
+{
+	for (int x = 0; x < width; x++)
+		dstPtr[x] = fillColor;
+}
+
+#ifdef SIMD_SSE2
+void gdrv::copy_transparent_row_sse2(int width, ColorRgba* dstPtr, const ColorRgba* srcPtr)
+{
+	const auto zero = _mm_setzero_si128();
+	int x = 0;
+	for (; x + 4 <= width; x += 4)
+	{
+		auto src = _mm_loadu_si128(reinterpret_cast<const __m128i*>(srcPtr + x));
+		auto keep = _mm_cmpeq_epi32(src, zero);
+		auto keepMask = _mm_movemask_epi8(keep);
+		if (keepMask == 0xFFFF)
+			continue;
+
+		auto dst = reinterpret_cast<__m128i*>(dstPtr + x);
+		if (keepMask)
+			src = _mm_or_si128(_mm_and_si128(keep, _mm_loadu_si128(dst)), src);
+		_mm_storeu_si128(dst, src);
+	}
+	copy_transparent_row(width - x, dstPtr + x, srcPtr + x);
+}
+
+void gdrv::fill_row_sse2(int width, ColorRgba* dstPtr, ColorRgba fillColor)
+{
+	const auto fill = _mm_set1_epi32(static_cast<int>(fillColor.Color));
+	int x = 0;
+	for (; x + 4 <= width; x += 4)
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dstPtr + x), fill);
+	fill_row(width - x, dstPtr + x, fillColor);
+}
+#endif
+
+#ifdef SIMD_AVX2
+SIMD_TARGET_AVX2 void gdrv::copy_transparent_row_avx2(int width, ColorRgba* dstPtr, const ColorRgba* srcPtr)
+{
+	const auto zero = _mm256_setzero_si256();
+	int x = 0;
+	for (; x + 8 <= width; x += 8)
+	{
+		auto src = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(srcPtr + x));
+		auto keep = _mm256_cmpeq_epi32(src, zero);
+		auto keepMask = _mm256_movemask_epi8(keep);
+		if (keepMask == -1)
+			continue;
+
+		auto dst = reinterpret_cast<__m256i*>(dstPtr + x);
+		if (keepMask)
+			src = _mm256_blendv_epi8(src, _mm256_loadu_si256(dst), keep);
+		_mm256_storeu_si256(dst, src);
+	}
+	copy_transparent_row(width - x, dstPtr + x, srcPtr + x);
+}
+
+SIMD_TARGET_AVX2 void gdrv::fill_row_avx2(int width, ColorRgba* dstPtr, ColorRgba fillColor)
+{
+	const auto fill = _mm256_set1_epi32(static_cast<int>(fillColor.Color));
+	int x = 0;
+	for (; x + 8 <= width; x += 8)
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dstPtr + x), fill);
+	fill_row(width - x, dstPtr + x, fillColor);
+}
+#endif
+
+#ifdef SIMD_NEON
+void gdrv::copy_transparent_row_neon(int width, ColorRgba* dstPtr, const ColorRgba* srcPtr)
+{
+	int x = 0;
+	for (; x + 4 <= width; x += 4)
+	{
+		auto src = vld1q_u32(reinterpret_cast<const uint32_t*>(srcPtr + x));
+		auto dst = reinterpret_cast<uint32_t*>(dstPtr + x);
+		vst1q_u32(dst, vbslq_u32(vtstq_u32(src, src), src, vld1q_u32(dst)));
+	}
+	copy_transparent_row(width - x, dstPtr + x, srcPtr + x);
+}
+
+void gdrv::fill_row_neon(int width, ColorRgba* dstPtr, ColorRgba fillColor)
+{
+	const auto fill = vdupq_n_u32(fillColor.Color);
+	int x = 0;
+	for (; x + 4 <= width; x += 4)
+		vst1q_u32(reinterpret_cast<uint32_t*>(dstPtr + x), fill);
+	fill_row(width - x, dstPtr + x, fillColor);
+}
+#endif
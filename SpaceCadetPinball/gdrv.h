@@ -45,18 +45,30 @@ private:
 
 static_assert(sizeof(ColorRgba) == 4, "Wrong size of RGBA color");
 
+// Run of non-transparent pixels in one bitmap row.
+struct gdrv_span
+{
+	uint16_t Start;
+	uint16_t Length;
+};
+
 struct gdrv_bitmap8
 {
 	gdrv_bitmap8(int width, int height);
 	gdrv_bitmap8(int width, int height, bool indexed);
 	gdrv_bitmap8(int width, int height, bool indexed, bool bmpBuff);
-	gdrv_bitmap8(const struct dat8BitBmpHeader& header);
+	gdrv_bitmap8(const struct dat8BitBmpHeader& header, char* indexedView = nullptr);
 	~gdrv_bitmap8();
 	void ScaleIndexed(float scaleX, float scaleY);
 	void CreateTexture(const char* scaleHint, int access);
-	void BlitToTexture();
+	size_t BlitToTexture();
+	void MarkDirty(int xOff, int yOff, int width, int height);
+	void BuildOpaqueSpans();
+	size_t OpaqueSpanMemory() const;
 	ColorRgba* BmpBufPtr1;
 	char* IndexedBmpPtr;
+	// False when IndexedBmpPtr points into the mapped .dat file.
+	bool IndexedOwned;
 	int Width;
 	int Height;
 	int Stride;
@@ -66,13 +78,31 @@ struct gdrv_bitmap8
 	int YPosition;
 	unsigned Resolution;
 	SDL_Texture* Texture;
+	// Regions written since the last BlitToTexture, tracked for streaming textures.
+	std::vector<SDL_Rect> DirtyRects;
+	bool TrackDirty;
+	// Opaque runs of all rows back to back, row y owns [RowSpans[y], RowSpans[y + 1]).
+	// Built for loaded sprites, empty for bitmaps that are drawn into at runtime.
+	std::vector<gdrv_span> OpaqueSpans;
+	std::vector<int> RowSpans;
+private:
+	static const size_t MaxDirtyRects = 8;
 };
 
 
+enum class SimdLevel;
+
+// One row of each gdrv blit, implemented per SIMD level.
+struct gdrv_row_kernels
+{
+	void (*CopyTransparent)(int width, ColorRgba* dstPtr, const ColorRgba* srcPtr);
+	void (*Fill)(int width, ColorRgba* dstPtr, ColorRgba fillColor);
+};
+
 class gdrv
 {
 public:
-	static int display_palette(ColorRgba* plt);
+	static int display_palette(ColorRgba* plt, bool applyToBitmaps = true);
 	static void fill_bitmap(gdrv_bitmap8* bmp, int width, int height, int xOff, int yOff, uint8_t fillChar);
 	static void fill_bitmap(gdrv_bitmap8* bmp, int width, int height, int xOff, int yOff, ColorRgba fillColor);
 	static void copy_bitmap(gdrv_bitmap8* dstBmp, int width, int height, int xOff, int yOff, gdrv_bitmap8* srcBmp,
@@ -85,4 +115,14 @@ public:
 	static void CreatePreview(gdrv_bitmap8& bmp);
 private:
 	static ColorRgba current_palette[256];
+
+	static const gdrv_row_kernels& Kernels(SimdLevel level);
+	static void copy_transparent_row(int width, ColorRgba* dstPtr, const ColorRgba* srcPtr);
+	static void copy_transparent_row_sse2(int width, ColorRgba* dstPtr, const ColorRgba* srcPtr);
+	static void copy_transparent_row_avx2(int width, ColorRgba* dstPtr, const ColorRgba* srcPtr);
+	static void copy_transparent_row_neon(int width, ColorRgba* dstPtr, const ColorRgba* srcPtr);
+	static void fill_row(int width, ColorRgba* dstPtr, ColorRgba fillColor);
+	static void fill_row_sse2(int width, ColorRgba* dstPtr, ColorRgba fillColor);
+	static void fill_row_avx2(int width, ColorRgba* dstPtr, ColorRgba fillColor);
+	static void fill_row_neon(int width, ColorRgba* dstPtr, ColorRgba fillColor);
 };
@@ -1,9 +1,11 @@
 ﻿#include "pch.h"
 #include "loader.h"
+#include "EventTrace.h"
 #include "GroupData.h"
 #include "TPinballComponent.h"
 #include "pb.h"
 #include "Sound.h"
+#include "WorkerPool.h"
 #include "zdrv.h"
 
 
@@ -44,6 +46,8 @@ int loader::loader_sound_count;
 DatFile* loader::loader_table;
 DatFile* loader::sound_record_table;
 soundListStruct loader::sound_list[65];
+soundPreloadStruct loader::sound_preload[65];
+WorkerPool* loader::sound_pool = nullptr;
 
 int loader::error(int errorCode, int captionCode)
 {
@@ -92,16 +96,95 @@ void loader::loadfrom(DatFile* datFile)
 		{
 			if (sound_count < 65)
 			{
-				sound_list[sound_count] = {nullptr, groupIndex, 0, 0};
+				sound_list[sound_count] = {nullptr, groupIndex, 0, 0, false};
 				sound_count++;
 			}
 		}
 	}
 	loader_sound_count = sound_count;
+	preload_sounds();
+}
+
+void loader::preload_sounds()
+{
+	if (pb::quickFlag)
+		return;
+
+	// Sounds used to be loaded from component constructors, one file open and decode at a time.
+	// Now all of them are decoded in the background, components get their ids right away.
+	// Durations feed table timers, they are read from the headers here so they do not depend on decode progress.
+	if (!sound_pool)
+		sound_pool = new WorkerPool(WorkerPool::DefaultThreadCount(2));
+	for (int index = 1; index < sound_count; ++index)
+	{
+		// File name is in lower case, while game data is usually in upper case.
+		std::string fileName = loader_table->field(sound_list[index].GroupIndex, FieldTypes::String);
+		if (pb::FullTiltMode)
+		{
+			// FT sounds are in SOUND subfolder
+			fileName.insert(0, 1, PathSeparator);
+			fileName.insert(0, "sound");
+		}
+
+		std::string filePath;
+		float duration = -1;
+		for (int i = 0; i < 2 && duration < 0; i++)
+		{
+			if (i == 1)
+				std::transform(fileName.begin(), fileName.end(), fileName.begin(),
+				               [](unsigned char c) { return std::toupper(c); });
+
+			filePath = pb::make_path_name(fileName);
+			auto file = fopenu(filePath.c_str(), "rb");
+			if (file)
+			{
+				WaveHeader wavHeader{};
+				fread(&wavHeader, 1, sizeof wavHeader, file);
+				fclose(file);
+				auto sampleCount = wavHeader.data_size / (wavHeader.channels * (wavHeader.bits_per_sample / 8.0));
+				duration = static_cast<float>(sampleCount / wavHeader.sample_rate);
+			}
+		}
+
+		sound_list[index].Duration = duration;
+		if (duration < 0)
+			continue;
+
+		sound_list[index].Pending = true;
+		auto preload = &sound_preload[index];
+		preload->Ready.store(false);
+		sound_pool->Submit([preload, filePath]()
+		{
+			preload->WavePtr = Sound::DecodeWaveFile(filePath);
+			preload->Ready.store(true, std::memory_order_release);
+		});
+	}
+}
+
+bool loader::claim_sound(int soundIndex)
+{
+	auto& sound = sound_list[soundIndex];
+	if (sound.Pending && sound_preload[soundIndex].Ready.load(std::memory_order_acquire))
+	{
+		sound.WavePtr = sound_preload[soundIndex].WavePtr;
+		sound.Pending = false;
+	}
+	return !sound.Pending;
+}
+
+void loader::wait_for_sounds()
+{
+	if (sound_pool)
+		sound_pool->Wait();
+	for (int index = 1; index < sound_count; ++index)
+		claim_sound(index);
 }
 
 void loader::unload()
 {
+	wait_for_sounds();
+	delete sound_pool;
+	sound_pool = nullptr;
 	for (int index = 1; index < sound_count; ++index)
 	{
 		Sound::FreeSound(sound_list[index].WavePtr);
@@ -130,54 +213,7 @@ int loader::get_sound_id(int groupIndex)
 		}
 	}
 
-	if (!sound_list[soundIndex].Loaded && !sound_list[soundIndex].WavePtr)
-	{
-		WaveHeader wavHeader{};
-
-		int soundGroupId = sound_list[soundIndex].GroupIndex;
-		sound_list[soundIndex].Duration = 0.0;
-		if (soundGroupId > 0 && !pb::quickFlag)
-		{
-			auto value = reinterpret_cast<int16_t*>(loader_table->field(soundGroupId,
-			                                                            FieldTypes::ShortValue));
-			if (value && *value == 202)
-			{
-				// File name is in lower case, while game data is usually in upper case.
-				std::string fileName = loader_table->field(soundGroupId, FieldTypes::String);
-				if (pb::FullTiltMode)
-				{
-					// FT sounds are in SOUND subfolder
-					fileName.insert(0, 1, PathSeparator);
-					fileName.insert(0, "sound");
-				}
-
-				std::string filePath;
-				float duration = -1;
-				for (int i = 0; i < 2; i++)
-				{
-					if (i == 1)
-						std::transform(fileName.begin(), fileName.end(), fileName.begin(),
-						               [](unsigned char c) { return std::toupper(c); });
-
-					filePath = pb::make_path_name(fileName);
-					auto file = fopenu(filePath.c_str(), "rb");
-					if (file)
-					{
-						fread(&wavHeader, 1, sizeof wavHeader, file);
-						fclose(file);
-						auto sampleCount = wavHeader.data_size / (wavHeader.channels * (wavHeader.bits_per_sample /
-							8.0));
-						duration = static_cast<float>(sampleCount / wavHeader.sample_rate);
-						break;
-					}
-				}
-
-				sound_list[soundIndex].Duration = duration;
-				sound_list[soundIndex].WavePtr = Sound::LoadWaveFile(filePath);
-			}
-		}
-	}
-
+	claim_sound(soundIndex);
 	++sound_list[soundIndex].Loaded;
 	return soundIndex;
 }
@@ -336,6 +372,10 @@ float loader::play_sound(int soundIndex, TPinballComponent *soundSource, const c
 {
 	if (soundIndex <= 0)
 		return 0.0;
+	EventTrace::Instant(TraceEventType::Sound, info, soundIndex, 0.0f);
+
+	// Still decoding: nothing plays, Duration is already known from the header.
+	claim_sound(soundIndex);
 	Sound::PlaySound(sound_list[soundIndex].WavePtr, pb::time_ticks, soundSource, info);
 	return sound_list[soundIndex].Duration;
 }
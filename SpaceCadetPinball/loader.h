@@ -6,6 +6,7 @@ class TPinballComponent;
 struct zmap_header_type;
 struct gdrv_bitmap8;
 class DatFile;
+class WorkerPool;
 
 struct errorMsg
 {
@@ -19,6 +20,15 @@ struct soundListStruct
 	int GroupIndex;
 	int Loaded;
 	float Duration;
+	// Submitted to the preloader and not picked up yet, plays as silence.
+	bool Pending;
+};
+
+// Written by a preloader worker, handed over to soundListStruct once Ready.
+struct soundPreloadStruct
+{
+	std::atomic<bool> Ready;
+	Mix_Chunk* WavePtr;
 };
 
 struct visualKickerStruct
@@ -112,4 +122,10 @@ private:
 	static int sound_count;
 	static int loader_sound_count;
 	static soundListStruct sound_list[65];
+	static soundPreloadStruct sound_preload[65];
+	static WorkerPool* sound_pool;
+
+	static void preload_sounds();
+	static void wait_for_sounds();
+	static bool claim_sound(int soundIndex);
 };
@@ -2,14 +2,21 @@
 #include "midi.h"
 
 
+#include "DatCache.h"
+#include "options.h"
 #include "pb.h"
+#include "winmain.h"
+#include "WorkerPool.h"
 
 
 std::vector<Mix_Music*> midi::LoadedTracks{};
 Mix_Music* midi::track1, * midi::track2, * midi::track3;
-MidiTracks midi::active_track, midi::NextTrack;
+MidiTracks midi::active_track, midi::NextTrack, midi::PendingTrack = MidiTracks::None;
 int midi::Volume = MIX_MAX_VOLUME;
-bool midi::IsPlaying = false, midi::MixOpen = false;
+bool midi::IsPlaying = false, midi::MixOpen = false, midi::PendingReplay = false;
+WorkerPool* midi::LoadPool = nullptr;
+midi_track_source midi::TrackSources[3];
+std::mutex midi::LoadMutex;
 
 constexpr uint32_t FOURCC(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
 {
@@ -67,9 +74,31 @@ int midi::music_init(bool mixOpen, int volume)
 	SetVolume(volume);
 	active_track = MidiTracks::None;
 	NextTrack = MidiTracks::None;
+	PendingTrack = MidiTracks::None;
 	IsPlaying = false;
 	track1 = track2 = track3 = nullptr;
 
+	if (options::Options.BackgroundMusicLoading && MixOpen && !pb::quickFlag)
+	{
+		// Tracks are loaded on a worker in order, a track requested before its load is done starts from
+		// poll_loading once it is ready. Track 1 does not wait for the other two.
+		LoadPool = new WorkerPool(1);
+		auto hasTrack1 = false;
+		if (pb::FullTiltMode)
+		{
+			hasTrack1 = queue_track(0, "TABA1");
+			queue_track(1, "TABA2");
+			queue_track(2, "TABA3");
+			if (!hasTrack1 && pb::FullTiltDemoMode)
+				hasTrack1 = queue_track(0, "DEMO");
+		}
+		else
+		{
+			hasTrack1 = queue_track(0, "PINBALL");
+		}
+		return hasTrack1;
+	}
+
 	if (pb::FullTiltMode)
 	{
 		track1 = load_track("TABA1");
@@ -89,9 +118,195 @@ int midi::music_init(bool mixOpen, int volume)
 	return track1 != nullptr;
 }
 
+bool midi::queue_track(int index, std::string fileName)
+{
+	auto& source = TrackSources[index];
+	source = {fileName, "", false, "", nullptr, false};
+	if (pb::FullTiltMode)
+	{
+		fileName.insert(0, 1, PathSeparator);
+		fileName.insert(0, "SOUND");
+	}
+
+	// Same search order as load_track_sub: MIDI, then MIDS, upper case name first.
+	for (auto isMidi : {true, false})
+	{
+		auto name = fileName + (isMidi ? ".MID" : ".MDS");
+		for (int i = 0; i < 2 && source.Path.empty(); i++)
+		{
+			if (i == 1)
+				std::transform(name.begin(), name.end(), name.begin(),
+				               [](unsigned char c) { return std::tolower(c); });
+			auto filePath = pb::make_path_name(name);
+			auto fileHandle = fopenu(filePath.c_str(), "rb");
+			if (fileHandle)
+			{
+				fclose(fileHandle);
+				source.Path = filePath;
+				source.IsMidi = isMidi;
+			}
+		}
+		if (!source.Path.empty())
+			break;
+	}
+	if (source.Path.empty())
+		return false;
+
+	LoadPool->Submit([&source]()
+	{
+		read_cached_track(source);
+		std::lock_guard<std::mutex> lock(LoadMutex);
+		source.Loaded = true;
+	});
+	return true;
+}
+
+void midi::read_cached_track(midi_track_source& source)
+{
+	// Audio rendered once from the MIDI, with any synthesizer, is played instead of live synthesis.
+	// SDL_mixer has no API to render MIDI offline, so these files come from outside the game.
+	for (auto extension : {".ogg", ".flac", ".wav"})
+	{
+		auto audioPath = winmain::PrefPath + source.Name + extension;
+		auto fileHandle = fopenu(audioPath.c_str(), "rb");
+		if (fileHandle)
+		{
+			fclose(fileHandle);
+			source.AudioPath = audioPath;
+			return;
+		}
+	}
+
+	auto sourceBytes = ReadFileBytes(source.Path);
+	if (!sourceBytes || source.IsMidi)
+	{
+		source.Midi = sourceBytes;
+		return;
+	}
+
+	// MIDS to MIDI conversion is done once, keyed by the content hash of the source file.
+	char key[32];
+	snprintf(key, sizeof key, ".%016llx.v%u.mid",
+	         static_cast<unsigned long long>(DatCache::HashData(reinterpret_cast<const char*>(sourceBytes->data()),
+	                                                            sourceBytes->size())), MidiCacheVersion);
+	delete sourceBytes;
+	auto midiPath = winmain::PrefPath + source.Name + key;
+	source.Midi = ReadFileBytes(midiPath);
+	if (source.Midi)
+		return;
+
+	source.Midi = MdsToMidi(source.Path);
+	if (!source.Midi)
+		return;
+	auto fileHandle = fopenu(midiPath.c_str(), "wb");
+	if (fileHandle)
+	{
+		fwrite(source.Midi->data(), 1, source.Midi->size(), fileHandle);
+		fclose(fileHandle);
+	}
+}
+
+std::vector<uint8_t>* midi::ReadFileBytes(const std::string& path)
+{
+	auto fileHandle = fopenu(path.c_str(), "rb");
+	if (!fileHandle)
+		return nullptr;
+
+	fseek(fileHandle, 0, SEEK_END);
+	auto fileSize = ftell(fileHandle);
+	fseek(fileHandle, 0, SEEK_SET);
+	auto bytes = new std::vector<uint8_t>(fileSize > 0 ? fileSize : 0);
+	if (bytes->empty() || fread(bytes->data(), 1, bytes->size(), fileHandle) != bytes->size())
+	{
+		delete bytes;
+		bytes = nullptr;
+	}
+	fclose(fileHandle);
+	return bytes;
+}
+
+void midi::finish_loading()
+{
+	if (!LoadPool)
+		return;
+
+	LoadPool->Wait();
+	claim_tracks();
+}
+
+void midi::claim_tracks()
+{
+	if (!LoadPool)
+		return;
+
+	// Finished tracks are moved out of TrackSources, the pool goes away with the last one.
+	auto loading = false;
+	{
+		std::lock_guard<std::mutex> lock(LoadMutex);
+		Mix_Music** tracks[]{&track1, &track2, &track3};
+		for (auto index = 0; index < 3; index++)
+		{
+			auto& source = TrackSources[index];
+			if (source.Path.empty())
+				continue;
+			if (!source.Loaded)
+			{
+				loading = true;
+				continue;
+			}
+
+			Mix_Music* music = nullptr;
+			if (!source.AudioPath.empty())
+			{
+				music = Mix_LoadMUS_RW(SDL_RWFromFile(source.AudioPath.c_str(), "rb"), 1);
+			}
+			else if (source.Midi)
+			{
+				auto rw = SDL_RWFromMem(source.Midi->data(), static_cast<int>(source.Midi->size()));
+				music = Mix_LoadMUS_RW(rw, 1);
+				delete source.Midi;
+			}
+			*tracks[index] = music;
+			if (music)
+				LoadedTracks.push_back(music);
+			source = {};
+		}
+	}
+
+	if (!loading)
+	{
+		delete LoadPool;
+		LoadPool = nullptr;
+	}
+}
+
+bool midi::track_loading(MidiTracks track)
+{
+	// Only checks, play_track can run on the game thread while tracks are claimed on the main thread.
+	if (!LoadPool || track == MidiTracks::None)
+		return false;
+	return !TrackSources[static_cast<int>(track) - static_cast<int>(MidiTracks::Track1)].Path.empty();
+}
+
+void midi::poll_loading()
+{
+	if (!LoadPool)
+		return;
+
+	claim_tracks();
+	if (PendingTrack != MidiTracks::None && !track_loading(PendingTrack))
+	{
+		auto track = PendingTrack;
+		PendingTrack = MidiTracks::None;
+		play_track(track, PendingReplay);
+	}
+}
+
 void midi::music_shutdown()
 {
 	music_stop();
+	PendingTrack = MidiTracks::None;
+	finish_loading();
 
 	for (auto midi : LoadedTracks)
 	{
@@ -178,6 +393,14 @@ Mix_Music* midi::load_track_sub(std::string fileName, bool isMidi)
 
 bool midi::play_track(MidiTracks track, bool replay)
 {
+	if (track_loading(track))
+	{
+		PendingTrack = track;
+		PendingReplay = replay;
+		return false;
+	}
+
+	PendingTrack = MidiTracks::None;
 	auto midi = TrackToMidi(track);
 	if (!midi || (!replay && active_track == track))
 		return false;
@@ -91,6 +91,22 @@ enum class MidiTracks
 	Track3
 };
 
+class WorkerPool;
+
+// Music file found by music_init, read in the background with Background Music Loading.
+// The worker only reads files and converts MIDS, Mix_Music is created by claim_tracks on the main thread.
+struct midi_track_source
+{
+	std::string Name;
+	std::string Path;
+	bool IsMidi;
+	// User supplied audio file that replaces the track, empty when there is none.
+	std::string AudioPath;
+	std::vector<uint8_t>* Midi;
+	// Set by the worker under LoadMutex once AudioPath and Midi are final.
+	bool Loaded;
+};
+
 class midi
 {
 public:
@@ -101,16 +117,28 @@ public:
 	static void SetVolume(int volume);
 	static bool play_track(MidiTracks track, bool replay);
 	static MidiTracks get_active_track();
+	static void poll_loading();
 private:
 	static std::vector<Mix_Music*> LoadedTracks;
 	static Mix_Music* track1, * track2, * track3;
-	static MidiTracks active_track, NextTrack;
+	static MidiTracks active_track, NextTrack, PendingTrack;
 	static int Volume;
-	static bool IsPlaying, MixOpen;
+	static bool IsPlaying, MixOpen, PendingReplay;
+	static WorkerPool* LoadPool;
+	static midi_track_source TrackSources[3];
+	static std::mutex LoadMutex;
 
 	static void StopPlayback();
 	static Mix_Music* load_track(std::string fileName);
 	static Mix_Music* load_track_sub(std::string fileName, bool isMidi);
+	static bool queue_track(int index, std::string fileName);
+	static const uint32_t MidiCacheVersion = 1;
+
+	static void read_cached_track(midi_track_source& source);
+	static std::vector<uint8_t>* ReadFileBytes(const std::string& path);
+	static void finish_loading();
+	static void claim_tracks();
+	static bool track_loading(MidiTracks track);
 	static Mix_Music* TrackToMidi(MidiTracks track);
 	static std::vector<uint8_t>* MdsToMidi(std::string file);
 };
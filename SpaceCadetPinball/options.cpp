@@ -173,9 +173,19 @@ optionsStruct options::Options
 	{"Debug Overlay Sounds", true},
 	{"Debug Overlay Ball Depth Grid", true},
 	{"Debug Overlay AABB", true},
+	{"Debug Overlay Render Stats", false},
 	{"FontFileName", ""},
 	{"Language", translations::GetCurrentLanguage()->ShortName},
 	{"Hide Cursor", false},
+	{"Timestamped Input", false},
+	{"Pipelined Frames", false},
+#ifdef __SWITCH__
+	{"Palette Baked Bitmaps", true},
+	{"Background Music Loading", true},
+#else
+	{"Palette Baked Bitmaps", false},
+	{"Background Music Loading", false},
+#endif
 };
 
 void options::InitPrimary()
@@ -286,7 +286,12 @@ struct optionsStruct
 	BoolOption DebugOverlaySounds;
 	BoolOption DebugOverlayBallDepthGrid;
 	BoolOption DebugOverlayAabb;
+	BoolOption DebugOverlayRenderStats;
 	StringOption FontFileName;
 	StringOption Language;
 	BoolOption HideCursor;
+	BoolOption TimestampedInput;
+	BoolOption PipelinedFrames;
+	BoolOption PaletteBakedBitmaps;
+	BoolOption BackgroundMusicLoading;
 };
@@ -3,80 +3,214 @@
 
 #include "gdrv.h"
 #include "GroupData.h"
+#include "StartupProfile.h"
+#include "WorkerPool.h"
 #include "zdrv.h"
 
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif (defined(__unix__) || defined(__APPLE__)) && !defined(__SWITCH__)
+#define PARTMAN_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 short partman::_field_size[] =
 {
 	2, -1, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0
 };
 
-DatFile* partman::load_records(LPCSTR lpFileName, bool fullTiltMode)
-{
-	datFileHeader header{};
-	dat8BitBmpHeader bmpHeader{};
-	dat16BitBmpHeader zMapHeader{};
+DatLoadStats partman::LastLoad{};
 
-	auto fileHandle = fopenu(lpFileName, "rb");
-	if (fileHandle == nullptr)
-		return nullptr;
 
-	fread(&header, 1, sizeof header, fileHandle);
-	if (strcmp("PARTOUT(4.0)RESOURCE", header.FileSignature) != 0)
+MappedFile* MappedFile::Open(LPCSTR fileName)
+{
+	auto file = new MappedFile();
+#if defined(_WIN32)
+	auto wideLength = MultiByteToWideChar(CP_UTF8, 0, fileName, -1, nullptr, 0);
+	std::wstring wideName(wideLength, L'\0');
+	MultiByteToWideChar(CP_UTF8, 0, fileName, -1, &wideName[0], wideLength);
+	auto handle = CreateFileW(wideName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+	                          FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle != INVALID_HANDLE_VALUE)
 	{
-		fclose(fileHandle);
-		return nullptr;
+		LARGE_INTEGER size{};
+		if (GetFileSizeEx(handle, &size) && size.QuadPart > 0)
+		{
+			file->MappingHandle = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (file->MappingHandle)
+			{
+				file->FileData = static_cast<char*>(MapViewOfFile(file->MappingHandle, FILE_MAP_READ, 0, 0, 0));
+				if (file->FileData)
+				{
+					file->FileSize = static_cast<size_t>(size.QuadPart);
+					file->Mapped = true;
+				}
+				else
+				{
+					CloseHandle(file->MappingHandle);
+					file->MappingHandle = nullptr;
+				}
+			}
+		}
+		CloseHandle(handle);
 	}
+#elif defined(PARTMAN_MMAP)
+	auto fd = open(fileName, O_RDONLY);
+	if (fd >= 0)
+	{
+		struct stat fileStat{};
+		if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0)
+		{
+			auto data = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data != MAP_FAILED)
+			{
+				file->FileData = static_cast<char*>(data);
+				file->FileSize = static_cast<size_t>(fileStat.st_size);
+				file->Mapped = true;
+			}
+		}
+		close(fd);
+	}
+#endif
 
-	auto datFile = new DatFile();
-	if (!datFile)
+	if (!file->Mapped)
 	{
+		// No mapping on this platform or it failed, read the whole file at once instead.
+		auto fileHandle = fopenu(fileName, "rb");
+		if (fileHandle == nullptr)
+		{
+			delete file;
+			return nullptr;
+		}
+
+		fseek(fileHandle, 0, SEEK_END);
+		auto size = ftell(fileHandle);
+		fseek(fileHandle, 0, SEEK_SET);
+		if (size > 0)
+		{
+			file->FileData = new char[size];
+			file->FileSize = fread(file->FileData, 1, size, fileHandle);
+		}
 		fclose(fileHandle);
+		if (size <= 0 || file->FileSize != static_cast<size_t>(size))
+		{
+			delete file;
+			return nullptr;
+		}
+	}
+	return file;
+}
+
+MappedFile::~MappedFile()
+{
+	if (!Mapped)
+	{
+		delete[] FileData;
+		return;
+	}
+
+#if defined(_WIN32)
+	UnmapViewOfFile(FileData);
+	CloseHandle(MappingHandle);
+#elif defined(PARTMAN_MMAP)
+	munmap(FileData, FileSize);
+#endif
+}
+
+
+DatFile* partman::load_records(LPCSTR lpFileName, bool fullTiltMode, int resolution)
+{
+	LastLoad = DatLoadStats{};
+
+	auto file = MappedFile::Open(lpFileName);
+	if (file == nullptr)
+		return nullptr;
+
+	DatReader reader{file->Data(), file->Size(), 0, false};
+	auto header = reader.Read<datFileHeader>();
+	header.FileSignature[sizeof header.FileSignature - 1] = '\0';
+	if (reader.Failed || strcmp("PARTOUT(4.0)RESOURCE", header.FileSignature) != 0)
+	{
+		delete file;
 		return nullptr;
 	}
 
+	auto& stats = LastLoad;
+	stats.FileSize = file->Size();
+	stats.Mapped = file->IsMapped();
+	stats.Allocations = stats.EstimatedPerFieldAllocations = 1 + (stats.Mapped ? 0 : 1);
+
+	auto datFile = new DatFile();
+	header.AppName[sizeof header.AppName - 1] = '\0';
+	header.Description[sizeof header.Description - 1] = '\0';
 	datFile->AppName = header.AppName;
 	datFile->Description = header.Description;
+	datFile->FileName = lpFileName;
+	datFile->ResolutionLoaded[resolution] = true;
 
+	// Unknown block is not used, per field reads had to allocate a buffer to skip it.
 	if (header.Unknown)
-	{
-		auto unknownBuf = new char[header.Unknown];
-		if (!unknownBuf)
-		{
-			fclose(fileHandle);
-			delete datFile;
-			return nullptr;
-		}
-		fread(unknownBuf, 1, header.Unknown, fileHandle);
-		delete[] unknownBuf;
-	}
+		stats.EstimatedPerFieldAllocations++;
+	reader.Take(header.Unknown);
 
 	datFile->Groups.reserve(header.NumberOfGroups);
-	bool abort = false;
-	for (auto groupIndex = 0; !abort && groupIndex < header.NumberOfGroups; ++groupIndex)
+	for (auto groupIndex = 0; !reader.Failed && groupIndex < header.NumberOfGroups; ++groupIndex)
 	{
-		auto entryCount = LRead<uint8_t>(fileHandle);
+		auto entryCount = reader.Read<uint8_t>();
 		auto groupData = new GroupData(groupIndex);
 		groupData->ReserveEntries(entryCount);
+		stats.Allocations += 2;
+		stats.EstimatedPerFieldAllocations += 2;
 
 		for (auto entryIndex = 0; entryIndex < entryCount; ++entryIndex)
 		{
-			auto entryData = new EntryData();
-			auto entryType = static_cast<FieldTypes>(LRead<uint8_t>(fileHandle));
-			entryData->EntryType = entryType;
+			auto entryType = static_cast<FieldTypes>(reader.Read<uint8_t>());
+			if (static_cast<size_t>(entryType) >= sizeof _field_size / sizeof _field_size[0])
+			{
+				reader.Failed = true;
+				break;
+			}
 
 			int fixedSize = _field_size[static_cast<int>(entryType)];
-			size_t fieldSize = fixedSize >= 0 ? fixedSize : LRead<uint32_t>(fileHandle);
-			entryData->FieldSize = static_cast<int>(fieldSize);
+			size_t fieldSize = fixedSize >= 0 ? fixedSize : reader.Read<uint32_t>();
+			if (reader.Failed)
+				break;
 
+			char* buffer;
+			auto ownsBuffer = true;
 			if (entryType == FieldTypes::Bitmap8bit)
 			{
-				fread(&bmpHeader, 1, sizeof(dat8BitBmpHeader), fileHandle);
+				auto offset = static_cast<long>(reader.Offset);
+				auto bmpHeader = reader.Read<dat8BitBmpHeader>();
 				assertm(bmpHeader.Size + sizeof(dat8BitBmpHeader) == fieldSize, "partman: Wrong bitmap field size");
 				assertm(bmpHeader.Resolution <= 2, "partman: bitmap resolution out of bounds");
 
-				auto bmp = new gdrv_bitmap8(bmpHeader);
-				entryData->Buffer = reinterpret_cast<char*>(bmp);
-				fread(bmp->IndexedBmpPtr, 1, bmpHeader.Size, fileHandle);
+				// Other resolutions are read by load_resolution when they are needed.
+				if (bmpHeader.Resolution != resolution)
+				{
+					datFile->DeferredEntries.push_back({groupIndex, entryType, bmpHeader.Resolution, offset, fieldSize});
+					reader.Take(bmpHeader.Size);
+					continue;
+				}
+
+				auto bmp = read_bitmap(reader, bmpHeader, stats.Mapped);
+				if (!bmp)
+					break;
+				buffer = reinterpret_cast<char*>(bmp);
+				stats.EstimatedPerFieldAllocations += 3;
+				if (bmp->IndexedOwned)
+					stats.Allocations += 3;
+				else
+				{
+					stats.Allocations += 2;
+					stats.PixelViews++;
+				}
 			}
 			else if (entryType == FieldTypes::Bitmap16bit)
 			{
@@ -84,7 +218,7 @@ DatFile* partman::load_records(LPCSTR lpFileName, bool fullTiltMode)
 				auto zMapResolution = 0u;
 				if (fullTiltMode)
 				{
-					zMapResolution = LRead<uint8_t>(fileHandle);
+					zMapResolution = reader.Read<uint8_t>();
 					fieldSize--;
 
 					// -1 means universal resolution, maybe. FT demo .006 is the only known user.	
@@ -94,48 +228,188 @@ DatFile* partman::load_records(LPCSTR lpFileName, bool fullTiltMode)
 					assertm(zMapResolution <= 2, "partman: zMap resolution out of bounds");
 				}
 
-				fread(&zMapHeader, 1, sizeof(dat16BitBmpHeader), fileHandle);
-				auto length = fieldSize - sizeof(dat16BitBmpHeader);
-
-				zmap_header_type* zMap;
-				if (zMapHeader.Stride * zMapHeader.Height * 2u == length)
+				if (static_cast<int>(zMapResolution) != resolution)
 				{
-					zMap = new zmap_header_type(zMapHeader.Width, zMapHeader.Height, zMapHeader.Stride);
-					zMap->Resolution = zMapResolution;
-					fread(zMap->ZPtr1, 1, length, fileHandle);
+					datFile->DeferredEntries.push_back({
+						groupIndex, entryType, static_cast<uint8_t>(zMapResolution), static_cast<long>(reader.Offset),
+						fieldSize
+					});
+					reader.Take(fieldSize);
+					continue;
 				}
-				else
-				{
-					// 3DPB .dat has zeroed zMap headers, in groups 497 and 498, skip them.
-					fseek(fileHandle, static_cast<int>(length), SEEK_CUR);
-					zMap = new zmap_header_type(0, 0, 0);
-				}
-				entryData->Buffer = reinterpret_cast<char*>(zMap);
+
+				// zMaps are flipped and strided on load, they always get their own copy.
+				auto zMap = read_zmap(reader, fieldSize, zMapResolution);
+				if (!zMap)
+					break;
+				buffer = reinterpret_cast<char*>(zMap);
+				stats.Allocations += 2;
+				stats.EstimatedPerFieldAllocations += 2;
 			}
 			else
 			{
-				auto entryBuffer = new char[fieldSize];
-				entryData->Buffer = entryBuffer;
-				if (!entryBuffer)
-				{
-					abort = true;
+				// Copied rather than viewed: the mapping has no alignment guarantees for the int/float arrays.
+				auto src = reader.Take(fieldSize);
+				if (!src)
 					break;
-				}
-				fread(entryBuffer, 1, fieldSize, fileHandle);
+				buffer = datFile->AllocateField(fieldSize);
+				memcpy(buffer, src, fieldSize);
+				ownsBuffer = false;
+				stats.EstimatedPerFieldAllocations++;
+				stats.PackedFields++;
 			}
 
+			auto entryData = new EntryData(entryType, buffer);
+			entryData->FieldSize = static_cast<int>(fieldSize);
+			entryData->OwnsBuffer = ownsBuffer;
 			groupData->AddEntry(entryData);
+			stats.Allocations++;
+			stats.EstimatedPerFieldAllocations++;
 		}
 
 		datFile->Groups.push_back(groupData);
 	}
+	stats.Allocations += datFile->FieldBlockCount();
+
+	auto success = !reader.Failed && datFile->Groups.size() == header.NumberOfGroups;
+	if (success && stats.Mapped && stats.PixelViews)
+		datFile->Mapping = file;
+	else
+		delete file;
+	if (!success)
+	{
+		delete datFile;
+		return nullptr;
+	}
+
+	StartupProfile::Begin("DatFile::Finalize");
+	StartupProfile::Detail("%d threads", DatFile::PostProcessThreads() + 1);
+	datFile->Finalize();
+	StartupProfile::End();
+	return datFile;
+}
+
+bool partman::load_resolution(DatFile* datFile, int resolution)
+{
+	if (datFile->ResolutionLoaded[resolution])
+		return true;
+
+	// The mapping is shared with the initial load when it was kept, otherwise the file is opened again.
+	auto file = datFile->Mapping;
+	if (file == nullptr)
+	{
+		file = MappedFile::Open(datFile->FileName.c_str());
+		if (file == nullptr)
+			return false;
+	}
+
+	// All entries are read before any is added, a failed read leaves the groups and deferred entries as they were.
+	DatReader reader{file->Data(), file->Size(), 0, false};
+	std::vector<std::pair<GroupData*, EntryData*>> entries;
+	for (const auto& deferred : datFile->DeferredEntries)
+	{
+		if (deferred.Resolution != resolution)
+			continue;
+
+		reader.Offset = deferred.Offset;
+		char* buffer;
+		if (deferred.EntryType == FieldTypes::Bitmap8bit)
+		{
+			auto bmpHeader = reader.Read<dat8BitBmpHeader>();
+			buffer = reinterpret_cast<char*>(read_bitmap(reader, bmpHeader, file == datFile->Mapping));
+		}
+		else
+		{
+			buffer = reinterpret_cast<char*>(read_zmap(reader, deferred.FieldSize, resolution));
+		}
+		if (!buffer)
+		{
+			reader.Failed = true;
+			break;
+		}
+
+		auto entryData = new EntryData(deferred.EntryType, buffer);
+		entryData->FieldSize = static_cast<int>(deferred.FieldSize);
+		entries.emplace_back(datFile->Groups[deferred.GroupIndex], entryData);
+	}
+	if (file != datFile->Mapping)
+		delete file;
+	if (reader.Failed)
+	{
+		for (const auto& entry : entries)
+			delete entry.second;
+		return false;
+	}
+
+	std::vector<GroupData*> groups;
+	for (const auto& entry : entries)
+	{
+		entry.first->AddEntry(entry.second);
+		if (groups.empty() || groups.back() != entry.first)
+			groups.push_back(entry.first);
+	}
 
-	fclose(fileHandle);
-	if (datFile->Groups.size() == header.NumberOfGroups)
+	// Palette is already set when resolution changes after the initial load.
+	WorkerPool pool(DatFile::PostProcessThreads());
+	pool.ParallelFor(static_cast<int>(groups.size()), [&groups, resolution](int index)
+	{
+		auto group = groups[index];
+		group->FinalizeGroup();
+		auto bmp = group->GetBitmap(resolution);
+		if (bmp)
+			gdrv::ApplyPalette(*bmp);
+	});
+
+	auto& deferredEntries = datFile->DeferredEntries;
+	deferredEntries.erase(std::remove_if(deferredEntries.begin(), deferredEntries.end(),
+	                                     [resolution](const DeferredEntry& deferred)
+	                                     {
+		                                     return deferred.Resolution == resolution;
+	                                     }), deferredEntries.end());
+	datFile->ResolutionLoaded[resolution] = true;
+	return true;
+}
+
+gdrv_bitmap8* partman::read_bitmap(DatReader& reader, const dat8BitBmpHeader& bmpHeader, bool indexedView)
+{
+	auto pixels = reader.Take(bmpHeader.Size);
+	if (!pixels)
+		return nullptr;
+
+	// Header values come from the file, rows of the 4 byte aligned width must fit into the field.
+	auto spliced = bmpHeader.IsFlagSet(bmp8Flags::Spliced);
+	auto indexedSize = spliced ? bmpHeader.Size : bmpHeader.Height * ((bmpHeader.Width + 3) & ~3);
+	if (bmpHeader.Width < 0 || bmpHeader.Height < 0 || indexedSize > bmpHeader.Size)
+		return nullptr;
+
+	// Spliced bitmaps are parsed as 16-bit words, an unaligned view would not do for them.
+	if (indexedView && !spliced)
+		return new gdrv_bitmap8(bmpHeader, const_cast<char*>(pixels));
+
+	auto bmp = new gdrv_bitmap8(bmpHeader);
+	memcpy(bmp->IndexedBmpPtr, pixels, indexedSize);
+	return bmp;
+}
+
+zmap_header_type* partman::read_zmap(DatReader& reader, size_t fieldSize, unsigned zMapResolution)
+{
+	auto zMapHeader = reader.Read<dat16BitBmpHeader>();
+	auto length = fieldSize - sizeof(dat16BitBmpHeader);
+	auto src = reader.Take(length);
+	if (!src)
+		return nullptr;
+
+	zmap_header_type* zMap;
+	if (zMapHeader.Stride * zMapHeader.Height * 2u == length)
+	{
+		zMap = new zmap_header_type(zMapHeader.Width, zMapHeader.Height, zMapHeader.Stride);
+		zMap->Resolution = zMapResolution;
+		memcpy(zMap->ZPtr1, src, length);
+	}
+	else
 	{
-		datFile->Finalize();
-		return datFile;
+		// 3DPB .dat has zeroed zMap headers, in groups 497 and 498, skip them.
+		zMap = new zmap_header_type(0, 0, 0);
 	}
-	delete datFile;
-	return nullptr;
+	return zMap;
 }
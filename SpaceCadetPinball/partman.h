@@ -56,18 +56,89 @@ static_assert(sizeof(datFileHeader) == 183, "Wrong size of datFileHeader");
 static_assert(sizeof(dat16BitBmpHeader) == 14, "Wrong size of zmap_header_type");
 
 
-class partman
+// Whole .dat file in memory, mapped where the platform allows it and read in one go elsewhere.
+class MappedFile
 {
 public:
-	static class DatFile* load_records(LPCSTR lpFileName, bool fullTiltMode);
+	static MappedFile* Open(LPCSTR fileName);
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const char* Data() const { return FileData; }
+	size_t Size() const { return FileSize; }
+	bool IsMapped() const { return Mapped; }
 private:
-	static short _field_size[];
+	MappedFile() = default;
+
+	char* FileData{};
+	size_t FileSize{};
+	bool Mapped{};
+#ifdef _WIN32
+	void* MappingHandle{};
+#endif
+};
+
+// Bounds checked cursor over a MappedFile, reads past the end set Failed instead of crashing.
+struct DatReader
+{
+	const char* Data;
+	size_t Size;
+	size_t Offset;
+	bool Failed;
+
+	const char* Take(size_t count)
+	{
+		if (Failed || count > Size - Offset)
+		{
+			Failed = true;
+			return nullptr;
+		}
+		auto ptr = Data + Offset;
+		Offset += count;
+		return ptr;
+	}
+
+	void Align(size_t alignment)
+	{
+		Take((alignment - Offset % alignment) % alignment);
+	}
 
 	template <typename T>
-	static T LRead(FILE* file)
+	T Read()
 	{
-		T Buffer{};
-		fread(&Buffer, 1, sizeof(T), file);
-		return Buffer;
+		T value{};
+		auto src = Take(sizeof(T));
+		if (src)
+			memcpy(&value, src, sizeof(T));
+		return value;
 	}
 };
+
+struct DatLoadStats
+{
+	size_t FileSize;
+	bool Mapped;
+	// Heap allocations made by the loader. The per field count is not measured, it is what the old
+	// loader would allocate for the fields read: one buffer per field plus the bitmap and zMap internals.
+	int Allocations;
+	int EstimatedPerFieldAllocations;
+	// Bitmaps that use pixels in the mapping and fields packed into shared blocks.
+	int PixelViews;
+	int PackedFields;
+};
+
+
+class partman
+{
+public:
+	static DatLoadStats LastLoad;
+
+	static class DatFile* load_records(LPCSTR lpFileName, bool fullTiltMode, int resolution);
+	static bool load_resolution(DatFile* datFile, int resolution);
+private:
+	static short _field_size[];
+
+	static gdrv_bitmap8* read_bitmap(DatReader& reader, const dat8BitBmpHeader& bmpHeader, bool indexedView);
+	static zmap_header_type* read_zmap(DatReader& reader, size_t fieldSize, unsigned zMapResolution);
+};
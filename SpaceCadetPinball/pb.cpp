@@ -3,7 +3,10 @@
 
 
 #include "control.h"
+#include "DatCache.h"
+#include "EventTrace.h"
 #include "fullscrn.h"
+#include "InputLatency.h"
 #include "high_score.h"
 #include "proj.h"
 #include "render.h"
@@ -14,6 +17,7 @@
 #include "timer.h"
 #include "winmain.h"
 #include "Sound.h"
+#include "StartupProfile.h"
 #include "TBall.h"
 #include "TDemo.h"
 #include "TEdgeSegment.h"
@@ -35,6 +39,7 @@ GameModes pb::game_mode = GameModes::GameOver;
 float pb::time_now = 0, pb::time_next = 0, pb::time_ticks_remainder = 0;
 float pb::BallMaxSpeed, pb::BallHalfRadius, pb::BallToBallCollisionDistance;
 float pb::IdleTimerMs = 0;
+std::vector<TimedTableInput> pb::QueuedFlipperInputs;
 bool pb::FullTiltMode = false, pb::FullTiltDemoMode = false, pb::cheat_mode = false, pb::demo_mode = false, pb::CreditsActive = false;
 std::string pb::DatFileName, pb::BasePath;
 ImU32 pb::TextBoxColor;
@@ -49,7 +54,19 @@ int pb::init()
 	if (DatFileName.empty())
 		return 1;
 	auto dataFilePath = make_path_name(DatFileName);
-	record_table = partman::load_records(dataFilePath.c_str(), FullTiltMode);
+	StartupProfile::Begin("DatCache::Load");
+	record_table = DatCache::Load(dataFilePath, FullTiltMode, fullscrn::GetResolution());
+	StartupProfile::End();
+	if (!record_table)
+	{
+		StartupProfile::Begin("partman::load_records");
+		record_table = partman::load_records(dataFilePath.c_str(), FullTiltMode, fullscrn::GetResolution());
+		const auto& load = partman::LastLoad;
+		StartupProfile::Detail("%zu KiB %s, %d allocations (~%d estimated per field), %d pixel views, %d packed fields",
+		                       load.FileSize / 1024, load.Mapped ? "mapped" : "read", load.Allocations,
+		                       load.EstimatedPerFieldAllocations, load.PixelViews, load.PackedFields);
+		StartupProfile::End();
+	}
 
 	auto useBmpFont = 0;
 	get_rc_int(Msg::TextBoxUseBitmapFont, &useBmpFont);
@@ -60,7 +77,17 @@ int pb::init()
 		return 1;
 
 	auto plt = (ColorRgba*)record_table->field_labeled("background", FieldTypes::Palette);
-	gdrv::display_palette(plt);
+	StartupProfile::Begin("Palette application");
+	if (!record_table->FromCache)
+		StartupProfile::Detail("%d threads", DatFile::PostProcessThreads() + 1);
+	gdrv::display_palette(plt, !record_table->FromCache);
+	StartupProfile::End();
+	if (!record_table->FromCache)
+	{
+		StartupProfile::Begin("DatCache::Save");
+		DatCache::Save(record_table, FullTiltMode, fullscrn::GetResolution());
+		StartupProfile::End();
+	}
 
 	auto backgroundBmp = record_table->GetBitmap(record_table->record_labeled("background"));
 	auto cameraInfoId = record_table->record_labeled("camera_info") + fullscrn::GetResolution();
@@ -93,7 +120,12 @@ int pb::init()
 		0,
 		0);
 
+	// Table construction is mostly record_labeled/field lookups into the .dat.
+	auto labelLookups = record_table->LabelLookups;
+	StartupProfile::Begin("loader::loadfrom");
 	loader::loadfrom(record_table);
+	StartupProfile::Detail("%d label lookups", record_table->LabelLookups - labelLookups);
+	StartupProfile::End();
 
 	mode_change(GameModes::InGame);
 
@@ -101,7 +133,11 @@ int pb::init()
 	timer::init(150);
 	score::init();
 
+	labelLookups = record_table->LabelLookups;
+	StartupProfile::Begin("TPinballTable construction");
 	MainTable = new TPinballTable();
+	StartupProfile::Detail("%d label lookups", record_table->LabelLookups - labelLookups);
+	StartupProfile::End();
 
 	high_score::read();
 	auto ball = MainTable->BallList.at(0);
@@ -123,11 +159,15 @@ int pb::uninit()
 	score::unload_msg_font();
 	loader::unload();
 	delete record_table;
+	record_table = nullptr;
 	high_score::write();
 	delete MainTable;
 	MainTable = nullptr;
 	timer::uninit();
 	render::uninit();
+	QueuedFlipperInputs.clear();
+	// Trace events point to component names that are gone now.
+	EventTrace::Clear();
 	return 0;
 }
 
@@ -300,7 +340,30 @@ void pb::frame(float dtMilliSec)
 
 	float dtSec = dtMilliSec * 0.001f;
 	time_next = time_now + dtSec;
-	timed_frame(dtSec);
+	if (!QueuedFlipperInputs.empty())
+	{
+		// Frame simulates the last dtSec of real time, inputs are applied at their offset into it.
+		auto frameEnd = SDL_GetTicks();
+		auto simulated = 0.0f;
+		for (const auto& input : QueuedFlipperInputs)
+		{
+			auto age = static_cast<float>(frameEnd - input.Timestamp) * 0.001f;
+			auto offset = Clamp(dtSec - age, simulated, dtSec);
+			if (offset > simulated)
+			{
+				timed_frame(offset - simulated);
+				simulated = offset;
+			}
+			MainTable->Message(input.Code, time_now + simulated);
+		}
+		QueuedFlipperInputs.clear();
+		if (simulated < dtSec)
+			timed_frame(dtSec - simulated);
+	}
+	else
+	{
+		timed_frame(dtSec);
+	}
 	time_now = time_next;
 
 	dtMilliSec += time_ticks_remainder;
@@ -528,7 +591,7 @@ void pb::loose_focus()
 		MainTable->Message(MessageCode::LooseFocus, time_now);
 }
 
-void pb::InputUp(GameInput input)
+void pb::InputUp(GameInput input, Uint32 timestamp)
 {
 	if (game_mode != GameModes::InGame || winmain::single_step || demo_mode)
 		return;
@@ -539,10 +602,10 @@ void pb::InputUp(GameInput input)
 		switch (binding)
 		{
 		case GameBindings::LeftFlipper:
-			MainTable->Message(MessageCode::LeftFlipperInputReleased, time_now);
+			FlipperInput(MessageCode::LeftFlipperInputReleased, timestamp);
 			break;
 		case GameBindings::RightFlipper:
-			MainTable->Message(MessageCode::RightFlipperInputReleased, time_now);
+			FlipperInput(MessageCode::RightFlipperInputReleased, timestamp);
 			break;
 		case GameBindings::Plunger:
 			MainTable->Message(MessageCode::PlungerInputReleased, time_now);
@@ -561,7 +624,7 @@ void pb::InputUp(GameInput input)
 	}
 }
 
-void pb::InputDown(GameInput input)
+void pb::InputDown(GameInput input, Uint32 timestamp)
 {
 	if (options::WaitingForInput())
 	{
@@ -591,10 +654,12 @@ void pb::InputDown(GameInput input)
 		switch (binding)
 		{
 		case GameBindings::LeftFlipper:
-			MainTable->Message(MessageCode::LeftFlipperInputPressed, time_now);
+			InputLatency::Begin(timestamp);
+			FlipperInput(MessageCode::LeftFlipperInputPressed, timestamp);
 			break;
 		case GameBindings::RightFlipper:
-			MainTable->Message(MessageCode::RightFlipperInputPressed, time_now);
+			InputLatency::Begin(timestamp);
+			FlipperInput(MessageCode::RightFlipperInputPressed, timestamp);
 			break;
 		case GameBindings::Plunger:
 			MainTable->Message(MessageCode::PlungerInputPressed, time_now);
@@ -796,3 +861,11 @@ float pb::BallToBallCollision(const ray_type& ray, const TBall& ball, TEdgeSegme
 
 	return collisionDistance;
 }
+
+void pb::FlipperInput(MessageCode code, Uint32 timestamp)
+{
+	if (options::Options.TimestampedInput && timestamp)
+		QueuedFlipperInputs.push_back({code, timestamp});
+	else
+		MainTable->Message(code, time_now);
+}
@@ -9,6 +9,7 @@ class DatFile;
 class TBall;
 class TTextBox;
 enum class Msg : int;
+enum class MessageCode;
 
 enum class GameModes
 {
@@ -16,6 +17,12 @@ enum class GameModes
 	GameOver = 2,
 };
 
+struct TimedTableInput
+{
+	MessageCode Code;
+	Uint32 Timestamp;
+};
+
 class UsingSdlHint
 {
 public:
@@ -69,8 +76,8 @@ public:
 	static void timed_frame(float timeDelta);
 	static void pause_continue();
 	static void loose_focus();
-	static void InputUp(GameInput input);
-	static void InputDown(GameInput input);
+	static void InputUp(GameInput input, Uint32 timestamp = 0);
+	static void InputDown(GameInput input, Uint32 timestamp = 0);
 	static void launch_ball();
 	static void end_game();
 	static void high_scores();
@@ -84,5 +91,7 @@ public:
 private:
 	static bool demo_mode;
 	static float IdleTimerMs;
+	static std::vector<TimedTableInput> QueuedFlipperInputs;
 	static float BallToBallCollision(const ray_type& ray, const TBall& ball, TEdgeSegment** edge, float collisionDistance);
+	static void FlipperInput(MessageCode code, Uint32 timestamp);
 };
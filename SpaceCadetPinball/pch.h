@@ -24,10 +24,15 @@
 //#include <iomanip>
 //#include <cstdlib>
 #include <vector>
+#include <deque>
 #include <algorithm>
 #include <cstring>
 #include <string>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
 #include <map>
 #include <unordered_map>
 #include <initializer_list>
@@ -3,11 +3,14 @@
 
 #include "fullscrn.h"
 #include "GroupData.h"
+#include "InputLatency.h"
 #include "options.h"
 #include "pb.h"
 #include "score.h"
+#include "simd.h"
 #include "TPinballTable.h"
 #include "winmain.h"
+#include "WorkerPool.h"
 #include "DebugOverlay.h"
 #include "proj.h"
 
@@ -18,6 +21,21 @@ rectangle_type render::vscreen_rect;
 gdrv_bitmap8 *render::vscreen, *render::background_bitmap, *render::ball_bitmap[20];
 zmap_header_type* render::zscreen;
 SDL_Rect render::DestinationRect{};
+bool render::ParallelTiles = true;
+render_update_stats render::LastUpdate{};
+int render::tile_columns, render::tile_rows;
+std::vector<render_tile> render::tiles;
+std::vector<int> render::dirty_tiles;
+WorkerPool* render::tile_pool;
+std::vector<render_sprite*> render::occlude_pool, render::occlude_query;
+int render::occlude_pool_garbage;
+unsigned render::next_list_order;
+bool render::occlude_list_built;
+gdrv_bitmap8* render::present_screen = nullptr;
+int render::present_offset_x, render::present_offset_y;
+render_update_stats render::update_history[StatsHistorySize]{};
+float render::upload_history[StatsHistorySize]{};
+int render::update_history_index = 0, render::upload_history_index = 0;
 
 render_sprite::render_sprite(VisualTypes visualType, gdrv_bitmap8* bmp, zmap_header_type* zMap,
 	int xPosition, int yPosition, rectangle_type* boundingRect)
@@ -26,7 +44,6 @@ render_sprite::render_sprite(VisualTypes visualType, gdrv_bitmap8* bmp, zmap_hea
 	ZMap = zMap;
 	VisualType = visualType;
 	DeleteFlag = false;
-	OccludedSprites = nullptr;
 	DirtyRect = rectangle_type{};
 	DirtyFlag = visualType != VisualTypes::Ball;
 	ZMapOffestX = 0;
@@ -73,7 +90,6 @@ render_sprite::render_sprite(VisualTypes visualType, gdrv_bitmap8* bmp, zmap_hea
 render_sprite::~render_sprite()
 {
 	render::RemoveSprite(*this);
-	delete OccludedSprites;
 }
 
 void render_sprite::set(gdrv_bitmap8* bmp, zmap_header_type* zMap, int xPos, int yPos)
@@ -113,6 +129,19 @@ void render::init(gdrv_bitmap8* bmp, int width, int height)
 	for (auto& ballBmp : ball_bitmap)
 		ballBmp = new gdrv_bitmap8(64, 64, false);
 
+	tile_columns = (width + TileSize - 1) / TileSize;
+	tile_rows = (height + TileSize - 1) / TileSize;
+	tiles.resize(tile_columns * tile_rows);
+	for (auto row = 0; row < tile_rows; row++)
+	{
+		for (auto column = 0; column < tile_columns; column++)
+		{
+			rectangle_type tileRect{column * TileSize, row * TileSize, TileSize, TileSize};
+			maths::rectangle_clip(tileRect, vscreen_rect, &tiles[row * tile_columns + column].Rect);
+		}
+	}
+	tile_pool = new WorkerPool(WorkerPool::DefaultThreadCount(3));
+
 	background_bitmap = bmp;
 	if (bmp)
 		gdrv::copy_bitmap(vscreen, width, height, 0, 0, bmp, 0, 0);
@@ -126,6 +155,11 @@ void render::uninit()
 {
 	delete vscreen;
 	delete zscreen;
+	delete present_screen;
+	present_screen = nullptr;
+	occlude_list_built = false;
+	occlude_pool.clear();
+	occlude_pool_garbage = 0;
 
 	// Sprite destructor removes it from the list.
 	while (!sprite_list.empty())
@@ -134,25 +168,32 @@ void render::uninit()
 		delete ball_list[0];
 	for (auto& ballBmp : ball_bitmap)
 		delete ballBmp;
+	tiles.clear();
+	dirty_tiles.clear();
+	delete tile_pool;
+	tile_pool = nullptr;
 	DebugOverlay::UnInit();
 }
 
 void render::recreate_screen_texture()
 {
-	vscreen->CreateTexture(options::Options.LinearFiltering ? "linear" : "nearest", SDL_TEXTUREACCESS_STREAMING);
+	auto screen = present_screen ? present_screen : vscreen;
+	screen->CreateTexture(options::Options.LinearFiltering ? "linear" : "nearest", SDL_TEXTUREACCESS_STREAMING);
 }
 
 void render::update()
 {
+	auto startCounter = SDL_GetPerformanceCounter();
+	LastUpdate = render_update_stats{};
 	unpaint_balls();
 
-	// Clip dirty sprites with vScreen, clear clipping (dirty) rectangles
+	// Clip dirty sprites with vScreen, assign clipping (dirty) rectangles to tiles
 	for (const auto sprite : sprite_list)
 	{
 		if (!sprite->DirtyFlag)
 			continue;
 
-		bool clearSprite = false;
+		LastUpdate.DirtySprites++;
 		switch (sprite->VisualType)
 		{
 		case VisualTypes::Sprite:
@@ -160,40 +201,54 @@ void render::update()
 				maths::enclosing_box(sprite->DirtyRectPrev, sprite->BmpRect, sprite->DirtyRect);
 
 			if (maths::rectangle_clip(sprite->DirtyRect, vscreen_rect, &sprite->DirtyRect))
-				clearSprite = true;
+				mark_dirty_tiles(sprite);
 			else
 				sprite->DirtyRect.Width = -1;
 			break;
 		case VisualTypes::Background:
 			if (maths::rectangle_clip(sprite->BmpRect, vscreen_rect, &sprite->DirtyRect))
-				clearSprite = !sprite->Bmp;
+				mark_dirty_tiles(sprite);
 			else
 				sprite->DirtyRect.Width = -1;
 			break;
 		default: break;
 		}
+		if (sprite->DirtyRect.Width > 0)
+			LastUpdate.DirtyArea += static_cast<int64_t>(sprite->DirtyRect.Width) * sprite->DirtyRect.Height;
+	}
 
-		if (clearSprite)
+	// Tiles cover disjoint parts of vScreen, dirty tracking is done above so that workers do not touch it.
+	auto trackDirty = vscreen->TrackDirty;
+	vscreen->TrackDirty = false;
+	if (ParallelTiles && static_cast<int>(dirty_tiles.size()) >= ParallelTileThreshold)
+	{
+		tile_pool->ParallelFor(static_cast<int>(dirty_tiles.size()), [](int index)
 		{
-			auto yPos = sprite->DirtyRect.YPosition;
-			auto width = sprite->DirtyRect.Width;
-			auto xPos = sprite->DirtyRect.XPosition;
-			auto height = sprite->DirtyRect.Height;
-			zdrv::fill(zscreen, width, height, xPos, yPos, 0xFFFF);
-			if (background_bitmap)
-				gdrv::copy_bitmap(vscreen, width, height, xPos, yPos, background_bitmap, xPos, yPos);
-			else
-				gdrv::fill_bitmap(vscreen, width, height, xPos, yPos, 0);
-		}
+			paint_tile(tiles[dirty_tiles[index]]);
+		});
+	}
+	else
+	{
+		for (auto index : dirty_tiles)
+			paint_tile(tiles[index]);
+	}
+	vscreen->TrackDirty = trackDirty;
+	LastUpdate.DirtyTiles = static_cast<int>(dirty_tiles.size());
+
+	for (auto index : dirty_tiles)
+	{
+		auto& tile = tiles[index];
+		LastUpdate.DepthTested += tile.DepthTested;
+		LastUpdate.PixelsWritten += tile.PixelsWritten;
+		tile.DirtySprites.clear();
 	}
+	dirty_tiles.clear();
 
-	// Paint dirty rectangles of dirty sprites
 	for (auto sprite : sprite_list)
 	{
 		if (!sprite->DirtyFlag)
 			continue;
 
-		repaint(*sprite);
 		sprite->DirtyFlag = false;
 		sprite->DirtyRectPrev = sprite->DirtyRect;
 		if (sprite->DeleteFlag)
@@ -201,12 +256,29 @@ void render::update()
 	}
 
 	paint_balls();
+	LastUpdate.Milliseconds = static_cast<double>(SDL_GetPerformanceCounter() - startCounter) * 1000.0 /
+		static_cast<double>(SDL_GetPerformanceFrequency());
+	update_history[update_history_index] = LastUpdate;
+	update_history_index = (update_history_index + 1) % StatsHistorySize;
+	InputLatency::Mark(LatencyStage::RenderUpdate);
 }
 
 void render::AddSprite(render_sprite& sprite)
 {
 	auto& list = sprite.VisualType == VisualTypes::Ball ? ball_list : sprite_list;
+	sprite.ListOrder = next_list_order++;
 	list.push_back(&sprite);
+
+	// Sprites added after the table was built only touch the lists of sprites they overlap.
+	if (occlude_list_built && in_occlude_index(sprite))
+	{
+		occlude_index_insert(sprite);
+		query_occlude_index(sprite.BoundingRect, occlude_query);
+		auto overlapping = occlude_query;
+		for (auto refSprite : overlapping)
+			update_occlude_list(*refSprite);
+		compact_occlude_pool();
+	}
 }
 
 void render::RemoveSprite(render_sprite& sprite)
@@ -215,6 +287,21 @@ void render::RemoveSprite(render_sprite& sprite)
 	auto it = std::find(list.begin(), list.end(), &sprite);
 	if (it != list.end())
 		list.erase(it);
+
+	if (occlude_list_built && in_occlude_index(sprite))
+	{
+		query_occlude_index(sprite.BoundingRect, occlude_query);
+		auto overlapping = occlude_query;
+		occlude_index_remove(sprite);
+		occlude_pool_garbage += sprite.OccludedCount;
+		sprite.OccludedCount = 0;
+		for (auto refSprite : overlapping)
+		{
+			if (refSprite != &sprite)
+				update_occlude_list(*refSprite);
+		}
+		compact_occlude_pool();
+	}
 }
 
 void render::set_background_zmap(zmap_header_type* zMap, int offsetX, int offsetY)
@@ -224,17 +311,76 @@ void render::set_background_zmap(zmap_header_type* zMap, int offsetX, int offset
 	zmap_offsetY = offsetY;
 }
 
-void render::repaint(const render_sprite& sprite)
+void render::mark_dirty_tiles(render_sprite* sprite)
 {
+	const auto& rect = sprite->DirtyRect;
+	vscreen->MarkDirty(rect.XPosition, rect.YPosition, rect.Width, rect.Height);
+
+	auto lastColumn = (rect.XPosition + rect.Width - 1) / TileSize;
+	auto lastRow = (rect.YPosition + rect.Height - 1) / TileSize;
+	for (auto row = rect.YPosition / TileSize; row <= lastRow; row++)
+	{
+		for (auto column = rect.XPosition / TileSize; column <= lastColumn; column++)
+		{
+			auto index = row * tile_columns + column;
+			auto& tile = tiles[index];
+			if (tile.DirtySprites.empty())
+				dirty_tiles.push_back(index);
+			tile.DirtySprites.push_back(sprite);
+		}
+	}
+}
+
+void render::paint_tile(render_tile& tile)
+{
+	// Same as a whole-screen pass: clear all dirty rectangles first, then repaint them.
 	rectangle_type clipRect{};
-	if (!sprite.OccludedSprites || sprite.VisualType == VisualTypes::Ball || sprite.DirtyRect.Width <= 0)
-		return;
+	tile.DepthTested = tile.PixelsWritten = 0;
+	for (const auto sprite : tile.DirtySprites)
+	{
+		if (sprite->VisualType == VisualTypes::Background && sprite->Bmp)
+			continue;
+		if (!maths::rectangle_clip(sprite->DirtyRect, tile.Rect, &clipRect))
+			continue;
 
-	for (auto refSprite : *sprite.OccludedSprites)
+		auto yPos = clipRect.YPosition;
+		auto width = clipRect.Width;
+		auto xPos = clipRect.XPosition;
+		auto height = clipRect.Height;
+		zdrv::fill(zscreen, width, height, xPos, yPos, 0xFFFF);
+		if (background_bitmap)
+			gdrv::copy_bitmap(vscreen, width, height, xPos, yPos, background_bitmap, xPos, yPos);
+		else
+			gdrv::fill_bitmap(vscreen, width, height, xPos, yPos, 0);
+		tile.PixelsWritten += width * height;
+	}
+
+	// Depth test can reject pixels, painted area is an upper bound of pixels written.
+	for (const auto sprite : tile.DirtySprites)
 	{
+		auto painted = repaint(*sprite, tile.Rect);
+		tile.DepthTested += painted;
+		tile.PixelsWritten += painted;
+	}
+}
+
+int64_t render::repaint(const render_sprite& sprite, const rectangle_type& tileRect)
+{
+	rectangle_type dirtyRect{}, clipRect{};
+	int64_t painted = 0;
+	if (!sprite.OccludedCount || sprite.VisualType == VisualTypes::Ball || sprite.DirtyRect.Width <= 0)
+		return painted;
+	if (!maths::rectangle_clip(sprite.DirtyRect, tileRect, &dirtyRect))
+		return painted;
+
+	for (auto index = sprite.OccludedIndex; index < sprite.OccludedIndex + sprite.OccludedCount; index++)
+	{
+		auto refSprite = occlude_pool[index];
 		if (!refSprite->DeleteFlag && refSprite->Bmp)
 		{
-			if (maths::rectangle_clip(refSprite->BmpRect, sprite.DirtyRect, &clipRect))
+			if (maths::rectangle_clip(refSprite->BmpRect, dirtyRect, &clipRect))
+			{
+				painted += clipRect.Width * clipRect.Height;
 				zdrv::paint(
 					clipRect.Width,
 					clipRect.Height,
@@ -250,11 +396,12 @@ void render::repaint(const render_sprite& sprite)
 					refSprite->ZMap,
 					clipRect.XPosition + refSprite->ZMapOffestY - refSprite->BmpRect.XPosition,
 					clipRect.YPosition + refSprite->ZMapOffestX - refSprite->BmpRect.YPosition);
+			}
 		}
 	}
+	return painted;
 }
 
-
 void render::paint_balls()
 {
 	// Sort ball sprites by ascending depth
@@ -272,6 +419,10 @@ void render::paint_balls()
 		{
 			int xPos = dirty->XPosition;
 			int yPos = dirty->YPosition;
+			auto area = dirty->Width * dirty->Height;
+			LastUpdate.BallSaveBytes += area * sizeof(ColorRgba);
+			LastUpdate.DepthTested += area;
+			LastUpdate.PixelsWritten += area;
 			gdrv::copy_bitmap(ball_bitmap[index], dirty->Width, dirty->Height, 0, 0, vscreen, xPos, yPos);
 			zdrv::paint_flat(
 				dirty->Width,
@@ -301,6 +452,10 @@ void render::unpaint_balls()
 	{
 		auto curBall = ball_list[index];
 		if (curBall->DirtyRect.Width > 0)
+		{
+			auto area = curBall->DirtyRect.Width * curBall->DirtyRect.Height;
+			LastUpdate.BallSaveBytes += area * sizeof(ColorRgba);
+			LastUpdate.PixelsWritten += area;
 			gdrv::copy_bitmap(
 				vscreen,
 				curBall->DirtyRect.Width,
@@ -310,6 +465,7 @@ void render::unpaint_balls()
 				ball_bitmap[index],
 				0,
 				0);
+		}
 
 		curBall->DirtyRectPrev = curBall->DirtyRect;
 	}
@@ -323,41 +479,122 @@ void render::shift(int offsetX, int offsetY)
 
 void render::build_occlude_list()
 {
-	std::vector<render_sprite*>* spriteArr = nullptr;
-	for (auto mainSprite : sprite_list)
+	// Bounding rects are binned into the tile grid, only sprites sharing a tile are tested for overlap.
+	for (auto& tile : tiles)
+		tile.Sprites.clear();
+	occlude_pool.clear();
+	occlude_pool_garbage = 0;
+
+	for (auto sprite : sprite_list)
 	{
-		if (mainSprite->OccludedSprites)
+		sprite->OccludedCount = 0;
+		if (in_occlude_index(*sprite))
+			occlude_index_insert(*sprite);
+	}
+	for (auto sprite : sprite_list)
+		update_occlude_list(*sprite);
+	occlude_list_built = true;
+}
+
+bool render::in_occlude_index(const render_sprite& sprite)
+{
+	return sprite.VisualType != VisualTypes::Ball && !sprite.DeleteFlag && sprite.BoundingRect.Width != -1;
+}
+
+void render::tile_range(const rectangle_type& rect, int& firstColumn, int& firstRow, int& lastColumn, int& lastRow)
+{
+	// Rects outside of vScreen are clamped to the border tiles, overlapping rects still share a tile.
+	firstColumn = Clamp(rect.XPosition / TileSize, 0, tile_columns - 1);
+	firstRow = Clamp(rect.YPosition / TileSize, 0, tile_rows - 1);
+	lastColumn = Clamp((rect.XPosition + rect.Width - 1) / TileSize, 0, tile_columns - 1);
+	lastRow = Clamp((rect.YPosition + rect.Height - 1) / TileSize, 0, tile_rows - 1);
+}
+
+void render::occlude_index_insert(render_sprite& sprite)
+{
+	int firstColumn, firstRow, lastColumn, lastRow;
+	tile_range(sprite.BoundingRect, firstColumn, firstRow, lastColumn, lastRow);
+	for (auto row = firstRow; row <= lastRow; row++)
+	{
+		for (auto column = firstColumn; column <= lastColumn; column++)
+			tiles[row * tile_columns + column].Sprites.push_back(&sprite);
+	}
+}
+
+void render::occlude_index_remove(render_sprite& sprite)
+{
+	int firstColumn, firstRow, lastColumn, lastRow;
+	tile_range(sprite.BoundingRect, firstColumn, firstRow, lastColumn, lastRow);
+	for (auto row = firstRow; row <= lastRow; row++)
+	{
+		for (auto column = firstColumn; column <= lastColumn; column++)
 		{
-			delete mainSprite->OccludedSprites;
-			mainSprite->OccludedSprites = nullptr;
+			auto& cell = tiles[row * tile_columns + column].Sprites;
+			cell.erase(std::remove(cell.begin(), cell.end(), &sprite), cell.end());
 		}
+	}
+}
 
-		if (!mainSprite->DeleteFlag && mainSprite->BoundingRect.Width != -1)
+void render::query_occlude_index(const rectangle_type& rect, std::vector<render_sprite*>& result)
+{
+	int firstColumn, firstRow, lastColumn, lastRow;
+	tile_range(rect, firstColumn, firstRow, lastColumn, lastRow);
+	result.clear();
+	for (auto row = firstRow; row <= lastRow; row++)
+	{
+		for (auto column = firstColumn; column <= lastColumn; column++)
 		{
-			if (!spriteArr)
-				spriteArr = new std::vector<render_sprite*>();
-
-			for (auto refSprite : sprite_list)
+			for (auto refSprite : tiles[row * tile_columns + column].Sprites)
 			{
-				if (!refSprite->DeleteFlag
-					&& refSprite->BoundingRect.Width != -1
-					&& maths::rectangle_clip(mainSprite->BoundingRect, refSprite->BoundingRect, nullptr))
-				{
-					spriteArr->push_back(refSprite);
-				}
-			}
-
-			if (mainSprite->Bmp && spriteArr->size() < 2)
-				spriteArr->clear();
-			if (!spriteArr->empty())
-			{
-				mainSprite->OccludedSprites = spriteArr;
-				spriteArr = nullptr;
+				if (!refSprite->DeleteFlag && maths::rectangle_clip(rect, refSprite->BoundingRect, nullptr))
+					result.push_back(refSprite);
 			}
 		}
 	}
 
-	delete spriteArr;
+	// Keep sprite_list order, it decides which sprite wins on equal depth.
+	std::sort(result.begin(), result.end(), [](const render_sprite* lhs, const render_sprite* rhs)
+	{
+		return lhs->ListOrder < rhs->ListOrder;
+	});
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+}
+
+void render::update_occlude_list(render_sprite& sprite)
+{
+	// Lists are never resized in place, the new one goes to the end of the pool.
+	occlude_pool_garbage += sprite.OccludedCount;
+	sprite.OccludedCount = 0;
+	if (!in_occlude_index(sprite))
+		return;
+
+	query_occlude_index(sprite.BoundingRect, occlude_query);
+	if (sprite.Bmp && occlude_query.size() < 2)
+		return;
+
+	sprite.OccludedIndex = static_cast<int>(occlude_pool.size());
+	sprite.OccludedCount = static_cast<int>(occlude_query.size());
+	occlude_pool.insert(occlude_pool.end(), occlude_query.begin(), occlude_query.end());
+}
+
+void render::compact_occlude_pool()
+{
+	if (occlude_pool_garbage * 2 < static_cast<int>(occlude_pool.size()))
+		return;
+
+	std::vector<render_sprite*> pool;
+	pool.reserve(occlude_pool.size() - occlude_pool_garbage);
+	for (auto sprite : sprite_list)
+	{
+		if (!sprite->OccludedCount)
+			continue;
+
+		auto first = occlude_pool.begin() + sprite->OccludedIndex;
+		sprite->OccludedIndex = static_cast<int>(pool.size());
+		pool.insert(pool.end(), first, first + sprite->OccludedCount);
+	}
+	occlude_pool.swap(pool);
+	occlude_pool_garbage = 0;
 }
 
 void render::SpriteViewer(bool* show)
@@ -383,6 +620,14 @@ void render::SpriteViewer(bool* show)
 			ImGui::EndMenuBar();
 		}
 
+		auto usage = pb::record_table->GetMemoryUsage();
+		ImGui::Text("Bitmaps: %d, indexed %.1f KiB, pixels %.1f KiB; zMaps: %d, %.1f KiB", usage.Bitmaps,
+		            usage.IndexedBytes / 1024.0, usage.PixelBytes / 1024.0, usage.ZMaps, usage.ZMapBytes / 1024.0);
+		ImGui::Text("Other fields: %.1f KiB, not loaded resolutions: %.1f KiB", usage.FieldBytes / 1024.0,
+		            usage.DeferredBytes / 1024.0);
+		ImGui::Text("Opaque spans: %.1f KiB, %.1f%% of %.1f KiB pixel data", usage.SpanBytes / 1024.0,
+		            usage.PixelBytes ? usage.SpanBytes * 100.0 / usage.PixelBytes : 0.0, usage.PixelBytes / 1024.0);
+
 		for (const auto group : pb::record_table->Groups)
 		{
 			bool emptyGroup = true;
@@ -406,9 +651,10 @@ void render::SpriteViewer(bool* show)
 					continue;
 
 				auto type = BitmapTypes[static_cast<uint8_t>(bmp->BitmapType)];
-				ImGui::Text("type:%s, size:%d, resolution: %dx%d, offset:%dx%d", type,
+				ImGui::Text("type:%s, size:%d, resolution: %dx%d, offset:%dx%d, spans:%d (%d bytes)", type,
 				            bmp->Resolution,
-				            bmp->Width, bmp->Height, bmp->XPosition, bmp->YPosition);
+				            bmp->Width, bmp->Height, bmp->XPosition, bmp->YPosition,
+				            static_cast<int>(bmp->OpaqueSpans.size()), static_cast<int>(bmp->OpaqueSpanMemory()));
 			}
 
 			for (int same = 0, i = 0; i <= 2; i++)
@@ -452,27 +698,282 @@ void render::SpriteViewer(bool* show)
 	ImGui::End();
 }
 
+void render::BlitBenchmark(bool* show)
+{
+	static std::vector<BlitBenchmarkResult> results;
+
+	if (ImGui::Begin("Blit Kernels", show, ImGuiWindowFlags_AlwaysAutoResize))
+	{
+		auto current = static_cast<int>(simd::Level);
+		for (auto level = 0; level < static_cast<int>(SimdLevel::Count); level++)
+		{
+			auto simdLevel = static_cast<SimdLevel>(level);
+			if (level)
+				ImGui::SameLine();
+			ImGui::BeginDisabled(!simd::Supported(simdLevel));
+			ImGui::RadioButton(simd::LevelName(simdLevel), &current, level);
+			ImGui::EndDisabled();
+		}
+		simd::Level = static_cast<SimdLevel>(current);
+		ImGui::Checkbox("Parallel tile repaint", &ParallelTiles);
+		ImGui::SameLine();
+		ImGui::Text("(%d workers)", tile_pool ? tile_pool->ThreadCount() : 0);
+
+		if (ImGui::Button("Run Benchmark"))
+			results = RunBlitBenchmark();
+		ImGui::SameLine();
+		if (ImGui::Button("Run Update Benchmark"))
+			results = RunUpdateBenchmark();
+
+		if (!results.empty() && ImGui::BeginTable("Results", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+		{
+			ImGui::TableSetupColumn("Kernel");
+			ImGui::TableSetupColumn("Level");
+			ImGui::TableSetupColumn("Time (ms)");
+			ImGui::TableSetupColumn("Mpixel/s");
+			ImGui::TableSetupColumn("Output");
+			ImGui::TableHeadersRow();
+
+			for (const auto& result : results)
+			{
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(result.Kernel);
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(simd::LevelName(result.Level));
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", result.Milliseconds);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.1f", result.Milliseconds > 0 ? result.Pixels / (result.Milliseconds * 1000.0) : 0.0);
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(result.Matches ? "match" : "MISMATCH");
+			}
+			ImGui::EndTable();
+		}
+	}
+	ImGui::End();
+}
+
+std::vector<BlitBenchmarkResult> render::RunBlitBenchmark()
+{
+	using BlitFunc = void(*)(gdrv_bitmap8& dstBmp, zmap_header_type& dstZMap, const render_sprite& sprite,
+	                         const rectangle_type& clipRect);
+	struct BlitKernel
+	{
+		const char* Name;
+		BlitFunc Blit;
+	};
+
+	// Each kernel draws every visible table sprite over a copy of the current screen.
+	static const BlitKernel kernels[]
+	{
+		{
+			"zdrv::paint", [](gdrv_bitmap8& dstBmp, zmap_header_type& dstZMap, const render_sprite& sprite,
+			                  const rectangle_type& clipRect)
+			{
+				zdrv::paint(clipRect.Width, clipRect.Height, &dstBmp, clipRect.XPosition, clipRect.YPosition,
+				            &dstZMap, clipRect.XPosition, clipRect.YPosition, sprite.Bmp,
+				            clipRect.XPosition - sprite.BmpRect.XPosition,
+				            clipRect.YPosition - sprite.BmpRect.YPosition, sprite.ZMap,
+				            clipRect.XPosition + sprite.ZMapOffestY - sprite.BmpRect.XPosition,
+				            clipRect.YPosition + sprite.ZMapOffestX - sprite.BmpRect.YPosition);
+			}
+		},
+		{
+			// Sprites drawn like a ball at mid-table depth.
+			"zdrv::paint_flat", [](gdrv_bitmap8& dstBmp, zmap_header_type& dstZMap, const render_sprite& sprite,
+			                       const rectangle_type& clipRect)
+			{
+				zdrv::paint_flat(clipRect.Width, clipRect.Height, &dstBmp, clipRect.XPosition, clipRect.YPosition,
+				                 &dstZMap, clipRect.XPosition, clipRect.YPosition, sprite.Bmp,
+				                 clipRect.XPosition - sprite.BmpRect.XPosition,
+				                 clipRect.YPosition - sprite.BmpRect.YPosition, 0x7FFF);
+			}
+		},
+		{
+			"gdrv::copy_bitmap_w_transparency", [](gdrv_bitmap8& dstBmp, zmap_header_type& dstZMap,
+			                                       const render_sprite& sprite, const rectangle_type& clipRect)
+			{
+				gdrv::copy_bitmap_w_transparency(&dstBmp, clipRect.Width, clipRect.Height, clipRect.XPosition,
+				                                 clipRect.YPosition, sprite.Bmp,
+				                                 clipRect.XPosition - sprite.BmpRect.XPosition,
+				                                 clipRect.YPosition - sprite.BmpRect.YPosition);
+			}
+		},
+		{
+			"gdrv::fill_bitmap", [](gdrv_bitmap8& dstBmp, zmap_header_type& dstZMap, const render_sprite& sprite,
+			                        const rectangle_type& clipRect)
+			{
+				gdrv::fill_bitmap(&dstBmp, clipRect.Width, clipRect.Height, clipRect.XPosition, clipRect.YPosition,
+				                  ColorRgba::Red());
+			}
+		},
+		{
+			"zdrv::fill", [](gdrv_bitmap8& dstBmp, zmap_header_type& dstZMap, const render_sprite& sprite,
+			                 const rectangle_type& clipRect)
+			{
+				zdrv::fill(&dstZMap, clipRect.Width, clipRect.Height, clipRect.XPosition, clipRect.YPosition,
+				           sprite.Depth);
+			}
+		},
+	};
+
+	// Output of each SIMD level is compared bit for bit against the scalar one.
+	const int iterations = 50;
+	const auto savedLevel = simd::Level;
+	const auto bmpSize = sizeof(ColorRgba) * vscreen->Stride * vscreen->Height;
+	const auto zMapSize = sizeof(uint16_t) * zscreen->Stride * zscreen->Height;
+	gdrv_bitmap8 dstBmp(vscreen->Width, vscreen->Height, false);
+	zmap_header_type dstZMap(zscreen->Width, zscreen->Height, zscreen->Stride);
+	std::vector<ColorRgba> refBmp;
+	std::vector<uint16_t> refZMap;
+	std::vector<BlitBenchmarkResult> results;
+
+	for (const auto& kernel : kernels)
+	{
+		refBmp.clear();
+		for (auto level = 0; level < static_cast<int>(SimdLevel::Count); level++)
+		{
+			simd::Level = static_cast<SimdLevel>(level);
+			if (!simd::Supported(simd::Level))
+				continue;
+
+			BlitBenchmarkResult result{kernel.Name, simd::Level, 0, 0, true};
+			uint64_t ticks = 0;
+			for (auto iteration = 0; iteration < iterations; iteration++)
+			{
+				std::memcpy(dstBmp.BmpBufPtr1, vscreen->BmpBufPtr1, bmpSize);
+				std::memcpy(dstZMap.ZPtr1, zscreen->ZPtr1, zMapSize);
+
+				auto start = SDL_GetPerformanceCounter();
+				for (auto sprite : sprite_list)
+				{
+					rectangle_type clipRect{};
+					if (sprite->Bmp && sprite->ZMap && maths::rectangle_clip(sprite->BmpRect, vscreen_rect, &clipRect))
+					{
+						kernel.Blit(dstBmp, dstZMap, *sprite, clipRect);
+						result.Pixels += clipRect.Width * clipRect.Height;
+					}
+				}
+				ticks += SDL_GetPerformanceCounter() - start;
+			}
+
+			if (refBmp.empty())
+			{
+				refBmp.assign(dstBmp.BmpBufPtr1, dstBmp.BmpBufPtr1 + vscreen->Stride * vscreen->Height);
+				refZMap.assign(dstZMap.ZPtr1, dstZMap.ZPtr1 + zscreen->Stride * zscreen->Height);
+			}
+			else
+			{
+				result.Matches = std::memcmp(refBmp.data(), dstBmp.BmpBufPtr1, bmpSize) == 0 &&
+					std::memcmp(refZMap.data(), dstZMap.ZPtr1, zMapSize) == 0;
+			}
+			result.Milliseconds = static_cast<double>(ticks) * 1000.0 /
+				static_cast<double>(SDL_GetPerformanceFrequency());
+			printf("%s %s: %.3f ms, %lld pixels, %s\n", result.Kernel, simd::LevelName(result.Level),
+			       result.Milliseconds, static_cast<long long>(result.Pixels), result.Matches ? "match" : "MISMATCH");
+			results.push_back(result);
+		}
+	}
+
+	simd::Level = savedLevel;
+	return results;
+}
+
+std::vector<BlitBenchmarkResult> render::RunUpdateBenchmark()
+{
+	struct UpdateCase
+	{
+		const char* Name;
+		bool AllSpritesDirty;
+		bool Parallel;
+	};
+
+	// Light show repaints every table sprite, single ball only moves the ball save-under.
+	// Tile pool output is compared bit for bit against the serial one.
+	static const UpdateCase cases[]
+	{
+		{"update: light show", true, false},
+		{"update: light show, tile pool", true, true},
+		{"update: single ball", false, false},
+		{"update: single ball, tile pool", false, true},
+	};
+
+	const int iterations = 50;
+	const auto savedParallel = ParallelTiles;
+	const auto bmpSize = sizeof(ColorRgba) * vscreen->Stride * vscreen->Height;
+	std::vector<ColorRgba> refBmp;
+	std::vector<BlitBenchmarkResult> results;
+
+	for (const auto& updateCase : cases)
+	{
+		ParallelTiles = updateCase.Parallel;
+		BlitBenchmarkResult result{updateCase.Name, simd::Level, 0, 0, true};
+		uint64_t ticks = 0;
+		for (auto iteration = 0; iteration < iterations; iteration++)
+		{
+			if (updateCase.AllSpritesDirty)
+			{
+				for (auto sprite : sprite_list)
+					sprite->DirtyFlag = !sprite->DeleteFlag;
+			}
+
+			auto start = SDL_GetPerformanceCounter();
+			update();
+			ticks += SDL_GetPerformanceCounter() - start;
+
+			if (updateCase.AllSpritesDirty)
+			{
+				for (auto sprite : sprite_list)
+					if (sprite->DirtyRectPrev.Width > 0)
+						result.Pixels += sprite->DirtyRectPrev.Width * sprite->DirtyRectPrev.Height;
+			}
+			for (auto ball : ball_list)
+				if (ball->DirtyRect.Width > 0)
+					result.Pixels += ball->DirtyRect.Width * ball->DirtyRect.Height;
+		}
+
+		if (!updateCase.Parallel)
+			refBmp.assign(vscreen->BmpBufPtr1, vscreen->BmpBufPtr1 + vscreen->Stride * vscreen->Height);
+		else
+			result.Matches = std::memcmp(refBmp.data(), vscreen->BmpBufPtr1, bmpSize) == 0;
+		result.Milliseconds = static_cast<double>(ticks) * 1000.0 /
+			static_cast<double>(SDL_GetPerformanceFrequency());
+		printf("%s %s: %.3f ms, %lld pixels, %s\n", result.Kernel, simd::LevelName(result.Level),
+		       result.Milliseconds, static_cast<long long>(result.Pixels), result.Matches ? "match" : "MISMATCH");
+		results.push_back(result);
+	}
+
+	ParallelTiles = savedParallel;
+	return results;
+}
+
 void render::PresentVScreen()
 {
-	vscreen->BlitToTexture();
+	// Pipelined frames present the copy taken before the simulation thread started on the next frame.
+	auto screen = present_screen ? present_screen : vscreen;
+	auto offsetX = present_screen ? present_offset_x : offset_x;
+	auto offsetY = present_screen ? present_offset_y : offset_y;
+	upload_history[upload_history_index] = static_cast<float>(screen->BlitToTexture());
+	upload_history_index = (upload_history_index + 1) % StatsHistorySize;
 
-	if (offset_x == 0 && offset_y == 0)
+	if (offsetX == 0 && offsetY == 0)
 	{
-		SDL_RenderCopy(winmain::Renderer, vscreen->Texture, nullptr, &DestinationRect);
+		SDL_RenderCopy(winmain::Renderer, screen->Texture, nullptr, &DestinationRect);
 	}
 	else
 	{
-		auto tableWidthCoef = static_cast<float>(pb::MainTable->Width) / vscreen->Width;
-		auto srcSeparationX = static_cast<int>(round(vscreen->Width * tableWidthCoef));
+		auto tableWidthCoef = static_cast<float>(pb::MainTable->Width) / screen->Width;
+		auto srcSeparationX = static_cast<int>(round(screen->Width * tableWidthCoef));
 		auto srcBoardRect = SDL_Rect
 		{
 			0, 0,
-			srcSeparationX, vscreen->Height
+			srcSeparationX, screen->Height
 		};
 		auto srcSidebarRect = SDL_Rect
 		{
 			srcSeparationX, 0,
-			vscreen->Width - srcSeparationX, vscreen->Height
+			screen->Width - srcSeparationX, screen->Height
 		};
 
 #if SDL_VERSION_ATLEAST(2, 0, 10)
@@ -480,8 +981,8 @@ void render::PresentVScreen()
 		auto dstSeparationX = DestinationRect.w * tableWidthCoef;
 		auto dstBoardRect = SDL_FRect
 		{
-			DestinationRect.x + offset_x * fullscrn::ScaleX,
-			DestinationRect.y + offset_y * fullscrn::ScaleY,
+			DestinationRect.x + offsetX * fullscrn::ScaleX,
+			DestinationRect.y + offsetY * fullscrn::ScaleY,
 			dstSeparationX, static_cast<float>(DestinationRect.h)
 		};
 		auto dstSidebarRect = SDL_FRect
@@ -490,18 +991,18 @@ void render::PresentVScreen()
 			DestinationRect.w - dstSeparationX, static_cast<float>(DestinationRect.h)
 		};
 
-		SDL_RenderCopyF(winmain::Renderer, vscreen->Texture, &srcBoardRect, &dstBoardRect);
-		SDL_RenderCopyF(winmain::Renderer, vscreen->Texture, &srcSidebarRect, &dstSidebarRect);
+		SDL_RenderCopyF(winmain::Renderer, screen->Texture, &srcBoardRect, &dstBoardRect);
+		SDL_RenderCopyF(winmain::Renderer, screen->Texture, &srcSidebarRect, &dstSidebarRect);
 #else
 		// SDL_RenderCopy cannot express sub pixel offset.
 		// Vscreen shift is required for that.
 		auto dstSeparationX = static_cast<int>(DestinationRect.w * tableWidthCoef);
-		auto scaledOffX = static_cast<int>(round(offset_x * fullscrn::ScaleX));
-		if (offset_x != 0 && scaledOffX == 0)
-			scaledOffX = Sign(offset_x);
-		auto scaledOffY = static_cast<int>(round(offset_y * fullscrn::ScaleY));
-		if (offset_y != 0 && scaledOffX == 0)
-			scaledOffY = Sign(offset_y);
+		auto scaledOffX = static_cast<int>(round(offsetX * fullscrn::ScaleX));
+		if (offsetX != 0 && scaledOffX == 0)
+			scaledOffX = Sign(offsetX);
+		auto scaledOffY = static_cast<int>(round(offsetY * fullscrn::ScaleY));
+		if (offsetY != 0 && scaledOffX == 0)
+			scaledOffY = Sign(offsetY);
 
 		auto dstBoardRect = SDL_Rect
 		{
@@ -514,8 +1015,8 @@ void render::PresentVScreen()
 			DestinationRect.w - dstSeparationX, DestinationRect.h
 		};
 
-		SDL_RenderCopy(winmain::Renderer, vscreen->Texture, &srcBoardRect, &dstBoardRect);
-		SDL_RenderCopy(winmain::Renderer, vscreen->Texture, &srcSidebarRect, &dstSidebarRect);
+		SDL_RenderCopy(winmain::Renderer, screen->Texture, &srcBoardRect, &dstBoardRect);
+		SDL_RenderCopy(winmain::Renderer, screen->Texture, &srcSidebarRect, &dstSidebarRect);
 #endif
 	}
 
@@ -524,3 +1025,117 @@ void render::PresentVScreen()
 		DebugOverlay::DrawOverlay();
 	}
 }
+
+void render::SetPipelined(bool enable)
+{
+	if (!vscreen || enable == (present_screen != nullptr))
+		return;
+
+	if (enable)
+	{
+		// vScreen keeps tracking dirty regions, they are copied to the present buffer by SyncPresentBuffer.
+		present_screen = new gdrv_bitmap8(vscreen->Width, vscreen->Height, false);
+		gdrv::copy_bitmap(present_screen, vscreen->Width, vscreen->Height, 0, 0, vscreen, 0, 0);
+		present_offset_x = offset_x;
+		present_offset_y = offset_y;
+		SDL_DestroyTexture(vscreen->Texture);
+		vscreen->Texture = nullptr;
+		vscreen->DirtyRects.clear();
+	}
+	else
+	{
+		delete present_screen;
+		present_screen = nullptr;
+	}
+	recreate_screen_texture();
+}
+
+void render::SyncPresentBuffer()
+{
+	if (!present_screen)
+		return;
+
+	// Called between frames while the simulation thread is idle.
+	for (const auto& rect : vscreen->DirtyRects)
+		gdrv::copy_bitmap(present_screen, rect.w, rect.h, rect.x, rect.y, vscreen, rect.x, rect.y);
+	vscreen->DirtyRects.clear();
+	present_offset_x = offset_x;
+	present_offset_y = offset_y;
+}
+
+bool render::ScreenDirty()
+{
+	auto screen = present_screen ? present_screen : vscreen;
+	return !screen->DirtyRects.empty();
+}
+
+const char* render::StatName(RenderStat stat)
+{
+	switch (stat)
+	{
+	case RenderStat::DirtySprites:
+		return "Dirty sprites";
+	case RenderStat::DirtyArea:
+		return "Dirty area, px";
+	case RenderStat::DepthTested:
+		return "Depth tested, px";
+	case RenderStat::PixelsWritten:
+		return "Pixels written, px";
+	case RenderStat::BallSaveBytes:
+		return "Ball save-under, bytes";
+	case RenderStat::UploadBytes:
+		return "Texture upload, bytes";
+	default:
+		return "";
+	}
+}
+
+float render::StatValue(RenderStat stat, int age)
+{
+	// Uploads are counted per present, everything else per render::update.
+	if (stat == RenderStat::UploadBytes)
+		return upload_history[(upload_history_index + StatsHistorySize - 1 - age) % StatsHistorySize];
+
+	const auto& stats = update_history[(update_history_index + StatsHistorySize - 1 - age) % StatsHistorySize];
+	switch (stat)
+	{
+	case RenderStat::DirtySprites:
+		return static_cast<float>(stats.DirtySprites);
+	case RenderStat::DirtyArea:
+		return static_cast<float>(stats.DirtyArea);
+	case RenderStat::DepthTested:
+		return static_cast<float>(stats.DepthTested);
+	case RenderStat::PixelsWritten:
+		return static_cast<float>(stats.PixelsWritten);
+	case RenderStat::BallSaveBytes:
+		return static_cast<float>(stats.BallSaveBytes);
+	default:
+		return 0;
+	}
+}
+
+void render::StatsPlots()
+{
+	float values[StatsHistorySize];
+	auto region = ImGui::GetContentRegionAvail();
+	for (auto index = 0; index < static_cast<int>(RenderStat::Count); index++)
+	{
+		auto stat = static_cast<RenderStat>(index);
+		float maxValue = 0, sum = 0;
+		for (auto age = 0; age < StatsHistorySize; age++)
+		{
+			auto value = StatValue(stat, age);
+			values[StatsHistorySize - 1 - age] = value;
+			maxValue = std::max(maxValue, value);
+			sum += value;
+		}
+
+		char overlay[96];
+		snprintf(overlay, sizeof overlay, "%s: %.0f, avg %.0f, max %.0f", StatName(stat),
+		         values[StatsHistorySize - 1], sum / StatsHistorySize, maxValue);
+		ImGui::PushID(index);
+		ImGui::PlotLines("", values, StatsHistorySize, 0, overlay, 0, std::max(maxValue, 1.0f),
+		                 ImVec2{region.x, 40});
+		ImGui::PopID();
+	}
+}
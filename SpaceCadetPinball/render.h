@@ -3,6 +3,8 @@
 #include "maths.h"
 #include "zdrv.h"
 
+class WorkerPool;
+
 enum class VisualTypes : char
 {
 	Background = 0,
@@ -22,9 +24,11 @@ struct render_sprite
 	int ZMapOffestY;
 	int ZMapOffestX;
 	rectangle_type DirtyRect{};
-	std::vector<render_sprite*>* OccludedSprites;
+	int OccludedIndex{};
+	int OccludedCount{};
 	rectangle_type BoundingRect{};
 	bool DirtyFlag{};
+	unsigned ListOrder{};
 
 	render_sprite(VisualTypes visualType, gdrv_bitmap8* bmp, zmap_header_type* zMap,
 	              int xPosition, int yPosition, rectangle_type* boundingRect);
@@ -33,6 +37,47 @@ struct render_sprite
 	void ball_set(gdrv_bitmap8* bmp, float depth, int xPos, int yPos);
 };
 
+// Square block of vScreen with the dirty sprites that touch it, tiles can be repainted independently.
+// Also a spatial index cell for sprites whose bounding rect touches it.
+struct render_tile
+{
+	rectangle_type Rect;
+	std::vector<render_sprite*> DirtySprites;
+	std::vector<render_sprite*> Sprites;
+	int64_t DepthTested, PixelsWritten;
+};
+
+struct BlitBenchmarkResult
+{
+	const char* Kernel;
+	SimdLevel Level;
+	double Milliseconds;
+	int64_t Pixels;
+	bool Matches;
+};
+
+struct render_update_stats
+{
+	double Milliseconds;
+	int DirtySprites;
+	int DirtyTiles;
+	int64_t DirtyArea;
+	int64_t DepthTested;
+	int64_t PixelsWritten;
+	int64_t BallSaveBytes;
+};
+
+enum class RenderStat
+{
+	DirtySprites,
+	DirtyArea,
+	DepthTested,
+	PixelsWritten,
+	BallSaveBytes,
+	UploadBytes,
+	Count
+};
+
 
 class render
 {
@@ -41,6 +86,9 @@ public:
 	static zmap_header_type* background_zmap;
 	static int zmap_offsetX, zmap_offsetY;
 	static SDL_Rect DestinationRect;
+	static bool ParallelTiles;
+	static render_update_stats LastUpdate;
+	static constexpr int StatsHistorySize = 256;
 
 	static void init(gdrv_bitmap8* bmp, int width, int height);
 	static void uninit();
@@ -52,15 +100,48 @@ public:
 	static void shift(int offsetX, int offsetY);
 	static void build_occlude_list();
 	static void SpriteViewer(bool* show);
+	static void BlitBenchmark(bool* show);
 	static void PresentVScreen();
+	static void SetPipelined(bool enable);
+	static void SyncPresentBuffer();
+	static bool ScreenDirty();
+	static const char* StatName(RenderStat stat);
+	static float StatValue(RenderStat stat, int age);
+	static void StatsPlots();
 private:
 	static std::vector<render_sprite*> sprite_list, ball_list;
 	static int offset_x, offset_y;
 	static rectangle_type vscreen_rect;
 	static gdrv_bitmap8* ball_bitmap[20];
 	static zmap_header_type* zscreen;
+	static constexpr int TileSize = 32, ParallelTileThreshold = 16;
+	static int tile_columns, tile_rows;
+	static std::vector<render_tile> tiles;
+	static std::vector<int> dirty_tiles;
+	static WorkerPool* tile_pool;
+	static std::vector<render_sprite*> occlude_pool, occlude_query;
+	static int occlude_pool_garbage;
+	static unsigned next_list_order;
+	static bool occlude_list_built;
+	static gdrv_bitmap8* present_screen;
+	static int present_offset_x, present_offset_y;
+	static render_update_stats update_history[StatsHistorySize];
+	static float upload_history[StatsHistorySize];
+	static int update_history_index, upload_history_index;
 
-	static void repaint(const render_sprite& sprite);
+	static void mark_dirty_tiles(render_sprite* sprite);
+	static void paint_tile(render_tile& tile);
+	static int64_t repaint(const render_sprite& sprite, const rectangle_type& tileRect);
+	static bool in_occlude_index(const render_sprite& sprite);
+	static void tile_range(const rectangle_type& rect, int& firstColumn, int& firstRow, int& lastColumn,
+	                       int& lastRow);
+	static void occlude_index_insert(render_sprite& sprite);
+	static void occlude_index_remove(render_sprite& sprite);
+	static void query_occlude_index(const rectangle_type& rect, std::vector<render_sprite*>& result);
+	static void update_occlude_list(render_sprite& sprite);
+	static void compact_occlude_pool();
 	static void paint_balls();
 	static void unpaint_balls();
+	static std::vector<BlitBenchmarkResult> RunBlitBenchmark();
+	static std::vector<BlitBenchmarkResult> RunUpdateBenchmark();
 };
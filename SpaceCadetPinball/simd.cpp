@@ -0,0 +1,56 @@
+#include "pch.h"
+#include "simd.h"
+
+SimdLevel simd::Level = simd::BestLevel();
+
+
+SimdLevel simd::BestLevel()
+{
+	auto best = SimdLevel::Scalar;
+	for (auto level = 0; level < static_cast<int>(SimdLevel::Count); level++)
+	{
+		if (Supported(static_cast<SimdLevel>(level)))
+			best = static_cast<SimdLevel>(level);
+	}
+	return best;
+}
+
+bool simd::Supported(SimdLevel level)
+{
+	switch (level)
+	{
+	case SimdLevel::Scalar:
+		return true;
+#ifdef SIMD_SSE2
+	case SimdLevel::Sse2:
+		return true;
+#endif
+#ifdef SIMD_AVX2
+	case SimdLevel::Avx2:
+		return SDL_HasAVX2() == SDL_TRUE;
+#endif
+#ifdef SIMD_NEON
+	case SimdLevel::Neon:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+const char* simd::LevelName(SimdLevel level)
+{
+	switch (level)
+	{
+	case SimdLevel::Scalar:
+		return "Scalar";
+	case SimdLevel::Sse2:
+		return "SSE2";
+	case SimdLevel::Avx2:
+		return "AVX2";
+	case SimdLevel::Neon:
+		return "NEON";
+	default:
+		return "";
+	}
+}
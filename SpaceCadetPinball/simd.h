@@ -0,0 +1,39 @@
+#pragma once
+
+// x86-64 always has SSE2, AVX2 kernels are compiled for a target and gated by a CPU check.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE2
+#define SIMD_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SIMD_TARGET_AVX2
+#endif
+
+enum class SimdLevel
+{
+	Scalar,
+	Sse2,
+	Avx2,
+	Neon,
+	Count,
+};
+
+class simd
+{
+public:
+	// Kernel set used by gdrv/zdrv, can be lowered at runtime to compare against the scalar path.
+	static SimdLevel Level;
+
+	static SimdLevel BestLevel();
+	static bool Supported(SimdLevel level);
+	static const char* LevelName(SimdLevel level);
+};
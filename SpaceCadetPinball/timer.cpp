@@ -1,61 +1,54 @@
 #include "pch.h"
 #include "timer.h"
 
+#include "EventTrace.h"
 #include "pb.h"
 
 int timer::SetCount;
-timer_struct* timer::ActiveList;
 int timer::MaxCount;
-int timer::Count;
+uint64_t timer::SequenceCount;
 timer_struct* timer::FreeList;
-timer_struct* timer::TimerBuffer;
+std::vector<timer_struct*> timer::TimerBlocks;
+std::vector<timer_struct*> timer::Heap;
+std::unordered_map<int, timer_struct*> timer::ActiveTimers;
+uint32_t timer::BenchmarkSeed;
+int timer::BenchmarkFires;
 
 int timer::init(int count)
 {
-	auto buf = new timer_struct[count];
-	TimerBuffer = buf;
-	if (!buf)
-		return 1;
-	Count = 0;
-	MaxCount = count;
+	MaxCount = 0;
 	SetCount = 1;
+	SequenceCount = 0;
+	FreeList = nullptr;
+	Heap.clear();
+	ActiveTimers.clear();
+	Grow(count);
 
-	for (int index = 0; index < count - 1; index++)
-		buf[index].NextTimer = &buf[index + 1];
-	buf[count - 1].NextTimer = nullptr;
-
-	ActiveList = nullptr;
-	FreeList = buf;
+	Heap.reserve(count);
+	ActiveTimers.reserve(count);
 	return 0;
 }
 
 void timer::uninit()
 {
-	delete[] TimerBuffer;
-	TimerBuffer = nullptr;
+	for (auto block : TimerBlocks)
+		delete[] block;
+	TimerBlocks.clear();
+	Heap.clear();
+	ActiveTimers.clear();
+	FreeList = nullptr;
+	MaxCount = 0;
 }
 
 int timer::kill(int timerId)
 {
-	timer_struct* current = ActiveList;
-	int index = 0;
-	timer_struct* prev = nullptr;
-	if (Count <= 0)
+	auto it = ActiveTimers.find(timerId);
+	if (it == ActiveTimers.end())
 		return 0;
-	while (timerId != current->TimerId)
-	{
-		++index;
-		prev = current;
-		current = current->NextTimer;
-		if (index >= Count)
-			return 0;
-	}
-	if (prev)
-		prev->NextTimer = current->NextTimer;
-	else
-		ActiveList = current->NextTimer;
 
-	--Count;
+	auto current = it->second;
+	ActiveTimers.erase(it);
+	Remove(current);
 	current->NextTimer = FreeList;
 	FreeList = current;
 	return timerId;
@@ -63,68 +56,45 @@ int timer::kill(int timerId)
 
 int timer::kill(void(* callback)(int, void*))
 {
-	auto count = 0;
-	timer_struct* current = ActiveList, * prev = nullptr;
-	for (auto index = 0; index < Count; index++)
+	// Callback kills are rare, a scan over active timers is good enough.
+	std::vector<int> timerIds;
+	for (auto current : Heap)
 	{
 		if (current->Callback == callback)
-		{
-			count++;
-			if (prev)
-				prev->NextTimer = current->NextTimer;
-			else
-				ActiveList = current->NextTimer;
-			current->NextTimer = FreeList;
-			FreeList = current;
-			if (--Count == index)
-				break;
-			current = current->NextTimer;
-		}
-		else
-		{
-			prev = current;
-			current = current->NextTimer;
-		}
+			timerIds.push_back(current->TimerId);
 	}
 
-	return count;
+	for (auto timerId : timerIds)
+		kill(timerId);
+	return static_cast<int>(timerIds.size());
 }
 
 int timer::set(float time, void* caller, void (* callback)(int, void*))
 {
-	if (Count >= MaxCount)
-		return 0;
+	return SetNamed(time, caller, callback, "timer");
+}
+
+int timer::SetNamed(float time, void* caller, void (* callback)(int, void*), const char* traceName)
+{
+	if (!FreeList)
+		Grow(MaxCount);
 
 	auto timer = FreeList;
 	FreeList = timer->NextTimer;
 	timer->NextTimer = nullptr;
 
-	auto prev = ActiveList;
-	auto current = ActiveList;
-
-	auto targetTime = pb::time_ticks + static_cast<int>(time * 1000.0f);
-	for (int index = 0; index < Count && targetTime >= current->TargetTime; ++index)
-	{
-		prev = current;
-		current = current->NextTimer;
-	}
-
-	if (current != prev)
-	{
-		timer->NextTimer = prev->NextTimer;
-		prev->NextTimer = timer;
-	}
-	else
-	{
-		timer->NextTimer = ActiveList;
-		ActiveList = timer;
-	}
-
 	timer->Caller = caller;
 	timer->Callback = callback;
+	timer->TraceName = traceName;
 	timer->TimerId = SetCount;
-	timer->TargetTime = targetTime;
-	Count++;
+	timer->TargetTime = pb::time_ticks + static_cast<int>(time * 1000.0f);
+	// Timers with equal target time fire in the order they were set.
+	timer->Sequence = SequenceCount++;
+
+	timer->HeapIndex = static_cast<int>(Heap.size());
+	Heap.push_back(timer);
+	SiftUp(timer->HeapIndex);
+	ActiveTimers[timer->TimerId] = timer;
 
 	SetCount++;
 	if (SetCount <= 0)
@@ -134,39 +104,193 @@ int timer::set(float time, void* caller, void (* callback)(int, void*))
 
 int timer::check()
 {
-	timer_struct* current = ActiveList;
 	int index = 0;
-	if (ActiveList)
+	if (!Heap.empty())
 	{
-		while (pb::time_ticks >= current->TargetTime)
+		while (pb::time_ticks >= Heap[0]->TargetTime)
 		{
-			--Count;
-			// Advance active list, move current to free
-			ActiveList = current->NextTimer;
-			current->NextTimer = FreeList;
-			FreeList = current;
-			if (current->Callback != nullptr)
-				current->Callback(current->TimerId, current->Caller);
-
-			current = ActiveList;
+			Fire(Heap[0]);
 			++index;
 			if (index > 1)
 				break;
-			if (!current)
+			if (Heap.empty())
 				return index;
 		}
-		while (current && pb::time_ticks >= current->TargetTime + 100)
+		// Catch up with timers that are late by more than 100ms.
+		while (!Heap.empty() && pb::time_ticks >= Heap[0]->TargetTime + 100)
 		{
-			--Count;
-			ActiveList = current->NextTimer;
-			current->NextTimer = FreeList;
-			FreeList = current;
-			if (current->Callback != nullptr)
-				current->Callback(current->TimerId, current->Caller);
-
-			current = ActiveList;
+			Fire(Heap[0]);
 			++index;
 		}
 	}
 	return index;
 }
+
+void timer::Grow(int count)
+{
+	if (count <= 0)
+		count = 1;
+
+	auto buf = new timer_struct[count];
+	TimerBlocks.push_back(buf);
+	for (int index = 0; index < count - 1; index++)
+		buf[index].NextTimer = &buf[index + 1];
+	buf[count - 1].NextTimer = FreeList;
+	FreeList = buf;
+	MaxCount += count;
+}
+
+bool timer::Earlier(const timer_struct* lhs, const timer_struct* rhs)
+{
+	if (lhs->TargetTime != rhs->TargetTime)
+		return lhs->TargetTime < rhs->TargetTime;
+	return lhs->Sequence < rhs->Sequence;
+}
+
+void timer::SiftUp(int index)
+{
+	auto timer = Heap[index];
+	while (index > 0)
+	{
+		auto parentIndex = (index - 1) / 2;
+		auto parent = Heap[parentIndex];
+		if (!Earlier(timer, parent))
+			break;
+
+		Heap[index] = parent;
+		parent->HeapIndex = index;
+		index = parentIndex;
+	}
+	Heap[index] = timer;
+	timer->HeapIndex = index;
+}
+
+void timer::SiftDown(int index)
+{
+	auto count = static_cast<int>(Heap.size());
+	auto timer = Heap[index];
+	while (true)
+	{
+		auto childIndex = index * 2 + 1;
+		if (childIndex >= count)
+			break;
+		if (childIndex + 1 < count && Earlier(Heap[childIndex + 1], Heap[childIndex]))
+			childIndex++;
+
+		auto child = Heap[childIndex];
+		if (!Earlier(child, timer))
+			break;
+
+		Heap[index] = child;
+		child->HeapIndex = index;
+		index = childIndex;
+	}
+	Heap[index] = timer;
+	timer->HeapIndex = index;
+}
+
+void timer::Remove(timer_struct* timer)
+{
+	auto index = timer->HeapIndex;
+	auto last = Heap.back();
+	Heap.pop_back();
+	timer->HeapIndex = -1;
+	if (last == timer)
+		return;
+
+	Heap[index] = last;
+	last->HeapIndex = index;
+	if (index > 0 && Earlier(last, Heap[(index - 1) / 2]))
+		SiftUp(index);
+	else
+		SiftDown(index);
+}
+
+void timer::Fire(timer_struct* timer)
+{
+	ActiveTimers.erase(timer->TimerId);
+	Remove(timer);
+	timer->NextTimer = FreeList;
+	FreeList = timer;
+
+	// Callback is allowed to set and kill timers, the struct can be reused before it returns.
+	auto callback = timer->Callback;
+	auto timerId = timer->TimerId;
+	auto caller = timer->Caller;
+	if (callback != nullptr)
+	{
+		EventTrace::Scope trace(TraceEventType::TimerFire, timer->TraceName, timerId, 0.0f);
+		callback(timerId, caller);
+	}
+}
+
+bool timer::RunBenchmark(const std::string& csvPath)
+{
+	// Light show load: every timer re-arms itself when it fires and 1% of them are killed and set again
+	// each 10 ms step. Runs from the command line before the table is loaded, on its own clock.
+	const int steps = 10000, stepMs = 10;
+	const int activeCounts[]{100, 300, 600, 1000};
+	std::vector<TimerBenchmarkResult> results;
+	for (auto activeCount : activeCounts)
+	{
+		init(activeCount);
+		pb::time_ticks = 0;
+		BenchmarkSeed = 1;
+		BenchmarkFires = 0;
+		TimerBenchmarkResult result{activeCount, 0, 0, 0, 0};
+		std::vector<int> timerIds(activeCount);
+
+		auto start = SDL_GetPerformanceCounter();
+		for (auto& timerId : timerIds)
+			timerId = set(BenchmarkDelay(), &timerId, BenchmarkCallback);
+		result.Sets += activeCount;
+		for (auto step = 0; step < steps; step++)
+		{
+			pb::time_ticks += stepMs;
+			check();
+			for (auto index = 0; index < activeCount / 100; index++)
+			{
+				BenchmarkSeed = BenchmarkSeed * 1664525u + 1013904223u;
+				auto& timerId = timerIds[(BenchmarkSeed >> 8) % activeCount];
+				kill(timerId);
+				timerId = set(BenchmarkDelay(), &timerId, BenchmarkCallback);
+			}
+			result.Kills += activeCount / 100;
+			result.Sets += activeCount / 100;
+		}
+		result.Milliseconds = static_cast<double>(SDL_GetPerformanceCounter() - start) * 1000.0 /
+			static_cast<double>(SDL_GetPerformanceFrequency());
+		result.Fires = BenchmarkFires;
+		result.Sets += BenchmarkFires;
+		uninit();
+		results.push_back(result);
+	}
+	pb::time_ticks = 0;
+
+	auto csv = fopenu(csvPath.c_str(), "w");
+	if (!csv)
+		return false;
+	fprintf(csv, "active,sets,kills,fires,ms,ns_per_op\n");
+	for (const auto& result : results)
+	{
+		auto operations = result.Sets + result.Kills + result.Fires;
+		fprintf(csv, "%d,%d,%d,%d,%.3f,%.1f\n", result.ActiveTimers, result.Sets, result.Kills, result.Fires,
+		        result.Milliseconds, operations > 0 ? result.Milliseconds * 1000000.0 / operations : 0.0);
+	}
+	fclose(csv);
+	return true;
+}
+
+float timer::BenchmarkDelay()
+{
+	// Fixed LCG so that runs are comparable, delays from 50 ms to 1 s.
+	BenchmarkSeed = BenchmarkSeed * 1664525u + 1013904223u;
+	return 0.05f + static_cast<float>((BenchmarkSeed >> 8) % 951) / 1000.0f;
+}
+
+void timer::BenchmarkCallback(int timerId, void* caller)
+{
+	BenchmarkFires++;
+	auto benchmarkTimerId = static_cast<int*>(caller);
+	*benchmarkTimerId = set(BenchmarkDelay(), caller, BenchmarkCallback);
+}
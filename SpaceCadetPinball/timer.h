@@ -1,12 +1,27 @@
 #pragma once
 
+class TPinballComponent;
+
 struct timer_struct
 {
 	int TargetTime;
 	void* Caller;
 	void (* Callback)(int, void*);
+	// Event trace name, the group name of component callers.
+	const char* TraceName;
 	timer_struct* NextTimer;
 	int TimerId;
+	int HeapIndex;
+	uint64_t Sequence;
+};
+
+struct TimerBenchmarkResult
+{
+	int ActiveTimers;
+	int Sets;
+	int Kills;
+	int Fires;
+	double Milliseconds;
 };
 
 class timer
@@ -17,13 +32,36 @@ public:
 	static int kill(int timerId);
 	static int kill(void (*callback)(int, void*));
 	static int set(float time, void* caller, void (* callback)(int, void*));
+
+	template <typename T, typename std::enable_if<std::is_base_of<TPinballComponent, T>::value, int>::type = 0>
+	static int set(float time, T* caller, void (* callback)(int, void*))
+	{
+		auto name = caller && caller->GroupName ? caller->GroupName : "component";
+		return SetNamed(time, caller, callback, name);
+	}
 	static int check();
+	// Timer pool under a light show like load, results are written as CSV. Not for use with a loaded table.
+	static bool RunBenchmark(const std::string& csvPath);
 
 private:
 	static int SetCount;
-	static timer_struct* ActiveList;
 	static int MaxCount;
-	static int Count;
+	static uint64_t SequenceCount;
 	static timer_struct* FreeList;
-	static timer_struct* TimerBuffer;
+	static std::vector<timer_struct*> TimerBlocks;
+	static std::vector<timer_struct*> Heap;
+	static std::unordered_map<int, timer_struct*> ActiveTimers;
+
+	static uint32_t BenchmarkSeed;
+	static int BenchmarkFires;
+
+	static void Grow(int count);
+	static bool Earlier(const timer_struct* lhs, const timer_struct* rhs);
+	static void SiftUp(int index);
+	static void SiftDown(int index);
+	static void Remove(timer_struct* timer);
+	static void Fire(timer_struct* timer);
+	static int SetNamed(float time, void* caller, void (* callback)(int, void*), const char* traceName);
+	static float BenchmarkDelay();
+	static void BenchmarkCallback(int timerId, void* caller);
 };
@@ -3,6 +3,8 @@
 
 
 Lang translations::CurrentLanguage = Lang::English;
+ImVector<ImWchar> translations::GlyphRanges;
+Lang translations::GlyphRangesLanguage = Lang::Max;
 const LanguageInfo translations::Languages[static_cast<int>(Lang::Max)] =
 {
 	{Lang::Arabic, "ar", "Arabic"},
@@ -77,8 +79,15 @@ const char* translations::GetTranslation(Msg id)
 	return text;
 }
 
-void translations::GetGlyphRange(ImVector<ImWchar>* ranges)
+const ImWchar* translations::GetGlyphRanges()
 {
+	// Ranges cover only the active language, kept across restarts until the language changes.
+	// The atlas references them until it is built, so they can not be a temporary.
+	if (GlyphRangesLanguage == CurrentLanguage)
+		return GlyphRanges.Data;
+
+	GlyphRanges.clear();
+	GlyphRangesLanguage = CurrentLanguage;
 	ImFontGlyphRangesBuilder builder;
 
 	for (int i = 0; i < (int)Msg::Max; i++)
@@ -91,7 +100,8 @@ void translations::GetGlyphRange(ImVector<ImWchar>* ranges)
 	}
 
 	builder.AddRanges(ImGui::GetIO().Fonts->GetGlyphRangesDefault());
-	builder.BuildRanges(ranges);
+	builder.BuildRanges(&GlyphRanges);
+	return GlyphRanges.Data;
 }
 
 const TextArray translations::Translations =
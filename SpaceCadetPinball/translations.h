@@ -323,9 +323,11 @@ public:
 	static const char* GetTranslation(Msg id);
 	static void SetCurrentLanguage(const char* short_name);
 	static const LanguageInfo* GetCurrentLanguage();
-	static void GetGlyphRange(ImVector<ImWchar>* ranges);
+	static const ImWchar* GetGlyphRanges();
 
 private:
 	static const TextArray Translations;
 	static Lang CurrentLanguage;
+	static ImVector<ImWchar> GlyphRanges;
+	static Lang GlyphRangesLanguage;
 };
@@ -7,13 +7,19 @@
 
 #include "control.h"
 #include "EmbeddedData.h"
+#include "EventTrace.h"
+#include "FrameDump.h"
 #include "fullscrn.h"
+#include "InputLatency.h"
 #include "midi.h"
 #include "options.h"
 #include "pb.h"
 #include "render.h"
 #include "Sound.h"
+#include "StartupProfile.h"
+#include "timer.h"
 #include "translations.h"
+#include "WorkerPool.h"
 #include "font_selection.h"
 
 constexpr const char* winmain::Version;
@@ -42,12 +48,14 @@ float winmain::gfrWindow = 5.0f;
 bool winmain::ShowAboutDialog = false;
 bool winmain::ShowImGuiDemo = false;
 bool winmain::ShowSpriteViewer = false;
+bool winmain::ShowBlitBenchmark = false;
 bool winmain::ShowExitPopup = false;
 bool winmain::LaunchBallEnabled = true;
 bool winmain::HighScoresEnabled = true;
 bool winmain::DemoActive = false;
 int winmain::MainMenuHeight = 0;
 std::string winmain::FpsDetails, winmain::PrevSdlError;
+std::string winmain::PrefPath;
 unsigned winmain::PrevSdlErrorCount = 0;
 double winmain::UpdateToFrameRatio;
 winmain::DurationMs winmain::TargetFrameTime;
@@ -55,9 +63,14 @@ optionsStruct& winmain::Options = options::Options;
 winmain::DurationMs winmain::SpinThreshold = DurationMs(0.005);
 WelfordState winmain::SleepState{};
 int winmain::CursorIdleCounter = 0;
+bool winmain::RedrawPending = true;
+unsigned winmain::IdleFrameCount = 0;
+ImU32 winmain::PrevUiHash = 0;
+bool winmain::ControllerDbLoaded = false;
 
 int winmain::WinMain(LPCSTR lpCmdLine)
 {
+	StartupProfile::Start();
 	std::set_new_handler(memalloc_failure);
 
 	printf("Game version: %s\n", Version);
@@ -66,7 +79,14 @@ int winmain::WinMain(LPCSTR lpCmdLine)
 	printf(" SDL_mixer %d.%d.%d;", SDL_MIXER_MAJOR_VERSION, SDL_MIXER_MINOR_VERSION, SDL_MIXER_PATCHLEVEL);
 	printf(" ImGui %s %s\n", IMGUI_VERSION, ImGuiRender);
 
+	// Frame dump runs headless: dummy video driver, software renderer and no audio.
+	if (FrameDump::Init(lpCmdLine))
+		SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+
+	StartupProfile::PrintEnabled = strstr(lpCmdLine, "-profile-startup") != nullptr;
+
 	// SDL init
+	StartupProfile::Begin("SDL init");
 	SDL_SetMainReady();
 	if (SDL_Init(SDL_INIT_TIMER | SDL_INIT_AUDIO | SDL_INIT_VIDEO |
 		SDL_INIT_EVENTS | SDL_INIT_JOYSTICK | SDL_INIT_GAMECONTROLLER) < 0)
@@ -74,6 +94,7 @@ int winmain::WinMain(LPCSTR lpCmdLine)
 		pb::ShowMessageBox(SDL_MESSAGEBOX_ERROR, "Could not initialize SDL2", SDL_GetError());
 		return 1;
 	}
+	StartupProfile::End();
 
 	pb::quickFlag = strstr(lpCmdLine, "-quick") != nullptr;
 
@@ -93,6 +114,7 @@ int winmain::WinMain(LPCSTR lpCmdLine)
 #endif
 
 	// SDL window
+	StartupProfile::Begin("Window and renderer");
 	SDL_Window* window = SDL_CreateWindow
 	(
 		pb::get_rc_string(Msg::STRING139),
@@ -119,7 +141,7 @@ int winmain::WinMain(LPCSTR lpCmdLine)
 
 	// If HW fails, fallback to SW SDL renderer.
 	SDL_Renderer* renderer = nullptr;
-	auto swOffset = strstr(lpCmdLine, "-sw") != nullptr ? 1 : 0;
+	auto swOffset = strstr(lpCmdLine, "-sw") != nullptr || FrameDump::Active ? 1 : 0;
 	for (int i = swOffset; i < 2 && !renderer; i++)
 	{
 		Renderer = renderer = SDL_CreateRenderer
@@ -139,6 +161,7 @@ int winmain::WinMain(LPCSTR lpCmdLine)
 		printf("Using SDL renderer: %s\n", rendererInfo.name);
 	SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
 	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "nearest");
+	StartupProfile::End();
 
 #ifndef __SWITCH__
 	auto prefPath = SDL_GetPrefPath("", "SpaceCadetPinball");
@@ -156,11 +179,25 @@ int winmain::WinMain(LPCSTR lpCmdLine)
     SDL_snprintf(basePath, basePath_len, "%s/Pinball/", cwd);
 #endif
 
+	PrefPath = prefPath;
 	printf("Using prefPath: %s\n", prefPath);
 	printf("Using basePath: %s\n", basePath);
 
+	// Timer benchmark needs the pref path for its report, it runs before any table timers exist.
+	if (strstr(lpCmdLine, "-benchmark-timers"))
+	{
+		return_value = timer::RunBenchmark(PrefPath + "timer_benchmark.csv") ? 0 : 1;
+		SDL_free(basePath);
+		SDL_free(prefPath);
+		SDL_DestroyRenderer(renderer);
+		SDL_DestroyWindow(window);
+		SDL_Quit();
+		return return_value;
+	}
+
 	// SDL mixer init
-	bool mixOpened = false, noAudio = strstr(lpCmdLine, "-noaudio") != nullptr;
+	bool mixOpened = false, noAudio = strstr(lpCmdLine, "-noaudio") != nullptr || FrameDump::Active;
+	StartupProfile::Begin("Mixer open");
 	if (!noAudio)
 	{
 		if ((Mix_Init(MIX_INIT_MID_Proxy) & MIX_INIT_MID_Proxy) == 0)
@@ -176,23 +213,7 @@ int winmain::WinMain(LPCSTR lpCmdLine)
 		else
 			mixOpened = true;
 	}
-
-	{
-		// Load SDL Game Controller definitions from DB
-		unsigned decompressedSize{};
-		const auto controllerDb = ImFontAtlas::DecompressCompressedStbData(
-			EmbeddedData::SDL_GameControllerDB_compressed_data,
-			EmbeddedData::SDL_GameControllerDB_compressed_size,
-			decompressedSize);
-		auto rw = SDL_RWFromMem(controllerDb, decompressedSize);
-		const auto added = SDL_GameControllerAddMappingsFromRW(rw, 1);
-		IM_FREE(controllerDb);
-		if (added < 0)
-		{
-			printf("Could not load game controller DB.\nSDL Error: %s\n", SDL_GetError());
-			SDL_ClearError();
-		}
-	}
+	StartupProfile::End();
 
 	auto resetAllOptions = strstr(lpCmdLine, "-reset") != nullptr;
 	do
@@ -208,17 +229,19 @@ int winmain::WinMain(LPCSTR lpCmdLine)
 		io.IniFilename = iniPath.c_str();
 
 		// First option initialization step: just load settings from .ini. Needs ImGui context.
+		StartupProfile::Begin("options::InitPrimary");
 		options::InitPrimary();
 		if (resetAllOptions)
 		{
 			resetAllOptions = false;
 			options::ResetAllOptions();
 		}
+		StartupProfile::End();
 
+		// Atlas is built here instead of on the first frame, so that its cost shows up in the profile.
+		StartupProfile::Begin("Font atlas build");
 		if (!Options.FontFileName.V.empty())
 		{
-			ImVector<ImWchar> ranges;
-			translations::GetGlyphRange(&ranges);
 			ImFontConfig fontConfig{};
 
 			// ToDo: further tweak font options, maybe try imgui_freetype
@@ -234,14 +257,15 @@ int winmain::WinMain(LPCSTR lpCmdLine)
 				fclose(fileHandle);
 
 				// ToDo: Bind font size to UI scale
-				if (io.Fonts->AddFontFromFileTTF(fileName, 13.f, &fontConfig, ranges.Data))
+				if (io.Fonts->AddFontFromFileTTF(fileName, 13.f, &fontConfig, translations::GetGlyphRanges()))
 					fontLoaded = true;
 			}
 
 			if (!fontLoaded)
 				printf("Failed to load font: %s, using embedded font.\n", fileName);
-			io.Fonts->Build();
 		}
+		io.Fonts->Build();
+		StartupProfile::End();
 		ImGui_Render_Init(renderer);
 		ImGui::StyleColorsDark();
 
@@ -258,19 +282,26 @@ int winmain::WinMain(LPCSTR lpCmdLine)
 			}
 		};
 		searchPaths.insert(searchPaths.end(), std::begin(PlatformDataPaths), std::end(PlatformDataPaths));
+		StartupProfile::Begin("pb::SelectDatFile");
 		pb::SelectDatFile(searchPaths);
+		StartupProfile::End();
 
 		// Second step: run updates that depend on .DAT file selection
 		options::InitSecondary();
 
+		StartupProfile::Begin("Sound and music init");
 		Sound::Init(mixOpened, Options.SoundChannels, Options.Sounds, Options.SoundVolume);
 		if (!mixOpened)
 			Options.Sounds = false;
 
 		if (!midi::music_init(mixOpened, Options.MusicVolume))
 			Options.Music = false;
+		StartupProfile::End();
 
-		if (pb::init())
+		StartupProfile::Begin("pb::init");
+		auto initResult = pb::init();
+		StartupProfile::End();
+		if (initResult)
 		{
 			std::string message = "The .dat file is missing.\n"
 				"Make sure that the game data is present in any of the following locations:\n";
@@ -288,27 +319,36 @@ int winmain::WinMain(LPCSTR lpCmdLine)
 		fullscrn::init();
 
 		pb::reset_table();
+		StartupProfile::Begin("First render::update");
 		pb::firsttime_setup();
+		StartupProfile::End();
 
-		if (strstr(lpCmdLine, "-fullscreen"))
+		if (FrameDump::Active)
 		{
-			Options.FullScreen = true;
+			return_value = FrameDump::Run();
 		}
-
-		if (!Options.FullScreen)
+		else
 		{
-			auto resInfo = &fullscrn::resolution_array[fullscrn::GetResolution()];
-			SDL_SetWindowSize(MainWindow, resInfo->TableWidth, resInfo->TableHeight);
-		}
-		SDL_ShowWindow(window);
-		fullscrn::set_screen_mode(Options.FullScreen);
+			if (strstr(lpCmdLine, "-fullscreen"))
+			{
+				Options.FullScreen = true;
+			}
 
-		if (strstr(lpCmdLine, "-demo"))
-			pb::toggle_demo();
-		else
-			pb::replay_level(false);
+			if (!Options.FullScreen)
+			{
+				auto resInfo = &fullscrn::resolution_array[fullscrn::GetResolution()];
+				SDL_SetWindowSize(MainWindow, resInfo->TableWidth, resInfo->TableHeight);
+			}
+			SDL_ShowWindow(window);
+			fullscrn::set_screen_mode(Options.FullScreen);
 
-		MainLoop();
+			if (strstr(lpCmdLine, "-demo"))
+				pb::toggle_demo();
+			else
+				pb::replay_level(false);
+
+			MainLoop();
+		}
 
 		options::uninit();
 		midi::music_shutdown();
@@ -345,6 +385,7 @@ void winmain::MainLoop()
 	double UpdateToFrameCounter = 0;
 	DurationMs sleepRemainder(0), frameDuration(TargetFrameTime);
 	auto prevTime = frameStart;
+	WorkerPool framePool(1);
 
 	while (true)
 	{
@@ -367,6 +408,9 @@ void winmain::MainLoop()
 		if (!ProcessWindowMessages() || bQuit)
 			break;
 
+		// Background music loads become Mix_Music here, while no game update is in flight.
+		midi::poll_loading();
+
 		if (has_focus)
 		{
 			if (mouse_down)
@@ -396,7 +440,7 @@ void winmain::MainLoop()
 				last_mouse_x = x;
 				last_mouse_y = y;
 			}
-			if (!single_step && !no_time_loss)
+			auto updateGame = [&]()
 			{
 				auto dt = static_cast<float>(frameDuration.count());
 				pb::frame(dt);
@@ -412,7 +456,17 @@ void winmain::MainLoop()
 					gfrOffset = (gfrOffset + 1) % gfrDisplay.size();
 				}
 				updateCounter++;
-			}
+			};
+
+			// Pipelined mode simulates the next frame on framePool while this one is presented.
+			// Debug overlay reads game state during present and forces the serial path.
+			auto pipelined = Options.PipelinedFrames && !Options.DebugOverlay;
+			render::SetPipelined(pipelined);
+			auto runUpdate = !single_step && !no_time_loss;
+			auto updateSubmitted = false, latencyPresentPending = false;
+			uint64_t presentCounter = 0;
+			if (runUpdate && !pipelined)
+				updateGame();
 			no_time_loss = false;
 
 			if (UpdateToFrameCounter >= UpdateToFrameRatio)
@@ -425,23 +479,67 @@ void winmain::MainLoop()
 				ImGui_Render_NewFrame();
 				ImGui::NewFrame();
 				RenderUi();
+				ImGui::Render();
+				auto uiHash = HashDrawData(ImGui::GetDrawData());
+#else
+				ImU32 uiHash = 0;
 #endif
-				SDL_RenderClear(Renderer);
-				// Alternative clear hack, clear might fail on some systems
-				// Todo: remove original clear, if save for all platforms
-				SDL_RenderFillRect(Renderer, nullptr);
-				render::PresentVScreen();
+
+				// UI above ran on the last completed frame, game state is handed to framePool from here on.
+				if (runUpdate && pipelined)
+				{
+					// Only a press that reached render::update before the handover is on this present.
+					latencyPresentPending = InputLatency::Pending(LatencyStage::Present);
+					render::SyncPresentBuffer();
+					framePool.Submit(updateGame);
+					updateSubmitted = true;
+				}
+
+				// Skip identical frames: no vScreen writes, same UI geometry and no window events.
+				if (RedrawPending || uiHash != PrevUiHash || render::ScreenDirty() ||
+					Options.DebugOverlay)
+				{
+					SDL_RenderClear(Renderer);
+					// Alternative clear hack, clear might fail on some systems
+					// Todo: remove original clear, if save for all platforms
+					SDL_RenderFillRect(Renderer, nullptr);
+					render::PresentVScreen();
 
 #ifndef __SWITCH__
-				ImGui::Render();
-				ImGui_Render_RenderDrawData(ImGui::GetDrawData());
+					ImGui_Render_RenderDrawData(ImGui::GetDrawData());
 #endif
 
-				SDL_RenderPresent(Renderer);
-				frameCounter++;
+					SDL_RenderPresent(Renderer);
+					StartupProfile::Finish();
+					if (updateSubmitted)
+						presentCounter = SDL_GetPerformanceCounter();
+					else
+						InputLatency::Mark(LatencyStage::Present);
+					frameCounter++;
+					IdleFrameCount = 0;
+				}
+				else
+				{
+					IdleFrameCount++;
+				}
+				RedrawPending = false;
+				PrevUiHash = uiHash;
 				UpdateToFrameCounter -= UpdateToFrameRatio;
 			}
 
+			if (updateSubmitted)
+			{
+				framePool.Wait();
+				if (latencyPresentPending && presentCounter)
+					InputLatency::Mark(LatencyStage::Present, nullptr, presentCounter);
+			}
+			else if (runUpdate && pipelined)
+			{
+				// No present this iteration, nothing to overlap with.
+				render::SyncPresentBuffer();
+				updateGame();
+			}
+
 			auto sdlError = SDL_GetError();
 			if (sdlError[0] || !PrevSdlError.empty())
 			{
@@ -589,6 +687,10 @@ void winmain::RenderUi()
 				ImGui::EndMenu();
 			}
 			ImGuiMenuItemWShortcut(GameBindings::ShowControlDialog);
+			if (ImGui::MenuItem("Sub-frame Flipper Input", nullptr, Options.TimestampedInput))
+			{
+				Options.TimestampedInput ^= true;
+			}
 			if (ImGui::BeginMenu("Language"))
 			{
 				auto currentLanguage = translations::GetCurrentLanguage();
@@ -637,6 +739,12 @@ void winmain::RenderUi()
 				{
 					midi::SetVolume(Options.MusicVolume);
 				}
+				if (ImGui::MenuItem("Load Music In Background", nullptr, Options.BackgroundMusicLoading))
+				{
+					// Tracks are loaded once in music_init.
+					Options.BackgroundMusicLoading ^= true;
+					Restart();
+				}
 				ImGui::EndMenu();
 			}
 
@@ -654,6 +762,12 @@ void winmain::RenderUi()
 				{
 					options::toggle(Menu1::WindowIntegerScale);
 				}
+				if (ImGui::MenuItem("Palette Baked Bitmaps", nullptr, Options.PaletteBakedBitmaps))
+				{
+					// Indexed pixels are dropped at load, table has to be reloaded to get them back.
+					Options.PaletteBakedBitmaps ^= true;
+					Restart();
+				}
 				if (ImGui::DragFloat("UI Scale", &Options.UIScale.V, 0.005f, 0.8f, 5,
 				                     "%.2f", ImGuiSliderFlags_AlwaysClamp))
 				{
@@ -692,6 +806,10 @@ void winmain::RenderUi()
 					SleepState = WelfordState{};
 					SpinThreshold = DurationMs::zero();
 				}
+				if (ImGui::MenuItem("Pipelined Frames", nullptr, Options.PipelinedFrames))
+				{
+					Options.PipelinedFrames ^= true;
+				}
 
 				if (changed)
 				{
@@ -774,6 +892,10 @@ void winmain::RenderUi()
 					pause(false);
 				ShowSpriteViewer ^= true;
 			}
+			if (ImGui::MenuItem("Blit Kernels", nullptr, ShowBlitBenchmark))
+			{
+				ShowBlitBenchmark ^= true;
+			}
 			if (pb::cheat_mode && ImGui::MenuItem("Frame Times", nullptr, DispGRhistory))
 			{
 				DispGRhistory ^= true;
@@ -802,6 +924,30 @@ void winmain::RenderUi()
 					Options.DebugOverlaySounds ^= true;
 				if (ImGui::MenuItem("Apply Collision Mask", nullptr, Options.DebugOverlayCollisionMask))
 					Options.DebugOverlayCollisionMask ^= true;
+				if (ImGui::MenuItem("Render Stats", nullptr, Options.DebugOverlayRenderStats))
+					Options.DebugOverlayRenderStats ^= true;
+				ImGui::EndMenu();
+			}
+			if (ImGui::BeginMenu("Event Trace"))
+			{
+				if (ImGui::MenuItem("Record", nullptr, EventTrace::Recording))
+				{
+					if (EventTrace::Recording)
+						EventTrace::Stop();
+					else
+						EventTrace::Start();
+				}
+				if (ImGui::MenuItem("Export Chrome Trace", nullptr, false, EventTrace::EventCount() > 0))
+				{
+					auto fileName = PrefPath + "event_trace.json";
+					if (EventTrace::ExportChromeTrace(fileName))
+						printf("Event trace saved to: %s\n", fileName.c_str());
+					else
+						printf("Failed to save event trace: %s\n", fileName.c_str());
+				}
+				if (ImGui::MenuItem("Clear", nullptr, false, EventTrace::EventCount() > 0))
+					EventTrace::Clear();
+				ImGui::Text("Events: %d", static_cast<int>(EventTrace::EventCount()));
 				ImGui::EndMenu();
 			}
 			if (ImGui::BeginMenu("Cheats"))
@@ -843,6 +989,8 @@ void winmain::RenderUi()
 	font_selection::RenderDialog();
 	if (ShowSpriteViewer)
 		render::SpriteViewer(&ShowSpriteViewer);
+	if (ShowBlitBenchmark)
+		render::BlitBenchmark(&ShowBlitBenchmark);
 	options::RenderControlDialog();
 	if (DispGRhistory)
 		RenderFrameTimeDialog();
@@ -946,7 +1094,7 @@ int winmain::event_handler(const SDL_Event* event)
 		return_value = 0;
 		return 0;
 	case SDL_JOYBUTTONDOWN:
-		pb::InputDown({InputTypes::GameController, event->jbutton.button});
+		pb::InputDown({InputTypes::GameController, event->jbutton.button}, event->jbutton.timestamp);
 		switch (event->jbutton.button) {
 			case 2: // HidNpadButton_X
 				new_game();
@@ -968,16 +1116,16 @@ int winmain::event_handler(const SDL_Event* event)
 		}
 		break;
 	case SDL_JOYBUTTONUP:
-		pb::InputUp({InputTypes::GameController, event->jbutton.button});
+		pb::InputUp({InputTypes::GameController, event->jbutton.button}, event->jbutton.timestamp);
 		break;
 	case SDL_KEYUP:
-		pb::InputUp({InputTypes::Keyboard, event->key.keysym.sym});
+		pb::InputUp({InputTypes::Keyboard, event->key.keysym.sym}, event->key.timestamp);
 		break;
 	case SDL_KEYDOWN:
 		if (event->key.repeat)
 			break;
 
-		pb::InputDown({InputTypes::Keyboard, event->key.keysym.sym});
+		pb::InputDown({InputTypes::Keyboard, event->key.keysym.sym}, event->key.timestamp);
 		if (!pb::cheat_mode)
 			break;
 
@@ -1041,7 +1189,7 @@ int winmain::event_handler(const SDL_Event* event)
 			}
 
 			if (!noInput)
-				pb::InputDown({InputTypes::Mouse, event->button.button});
+				pb::InputDown({InputTypes::Mouse, event->button.button}, event->button.timestamp);
 		}
 		break;
 	case SDL_MOUSEBUTTONUP:
@@ -1062,10 +1210,11 @@ int winmain::event_handler(const SDL_Event* event)
 			}
 
 			if (!noInput)
-				pb::InputUp({InputTypes::Mouse, event->button.button});
+				pb::InputUp({InputTypes::Mouse, event->button.button}, event->button.timestamp);
 		}
 		break;
 	case SDL_WINDOWEVENT:
+		RedrawPending = true;
 		switch (event->window.event)
 		{
 		case SDL_WINDOWEVENT_FOCUS_GAINED:
@@ -1095,7 +1244,15 @@ int winmain::event_handler(const SDL_Event* event)
 		default: ;
 		}
 		break;
+	case SDL_RENDER_TARGETS_RESET:
+	case SDL_RENDER_DEVICE_RESET:
+		// Presents upload only dirty regions, a reset texture has to be recreated and filled in full.
+		render::recreate_screen_texture();
+		RedrawPending = true;
+		break;
 	case SDL_JOYDEVICEADDED:
+		// Mappings decide what SDL_IsGameController accepts, they have to be in before the check.
+		LoadControllerDb();
 		if (SDL_IsGameController(event->jdevice.which))
 		{
 			SDL_GameControllerOpen(event->jdevice.which);
@@ -1111,10 +1268,10 @@ int winmain::event_handler(const SDL_Event* event)
 		}
 		break;
 	case SDL_CONTROLLERBUTTONDOWN:
-		pb::InputDown({InputTypes::GameController, event->cbutton.button});
+		pb::InputDown({InputTypes::GameController, event->cbutton.button}, event->cbutton.timestamp);
 		break;
 	case SDL_CONTROLLERBUTTONUP:
-		pb::InputUp({InputTypes::GameController, event->cbutton.button});
+		pb::InputUp({InputTypes::GameController, event->cbutton.button}, event->cbutton.timestamp);
 		break;
 	default: ;
 	}
@@ -1128,6 +1285,16 @@ int winmain::ProcessWindowMessages()
 	SDL_Event event;
 	if (has_focus)
 	{
+		// Paused with nothing to redraw, wait for events instead of spinning at full FPS.
+		if (single_step && IdleFrameCount > 1)
+		{
+			idleWait = std::min(idleWait + static_cast<int>(TargetFrameTime.count()), 500);
+			if (!SDL_WaitEventTimeout(&event, idleWait))
+				return 1;
+			if (!event_handler(&event))
+				return 0;
+		}
+
 		idleWait = static_cast<int>(TargetFrameTime.count());
 		while (SDL_PollEvent(&event))
 		{
@@ -1189,6 +1356,29 @@ void winmain::a_dialog()
 				}
 				ImGui::EndTabItem();
 			}
+			if (StartupProfile::Finished() && ImGui::BeginTabItem("Startup"))
+			{
+				ImGui::Text("First frame: %.2fms after start", StartupProfile::TotalMilliseconds());
+				if (ImGui::BeginTable("StartupProfile", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingFixedFit))
+				{
+					ImGui::TableSetupColumn("Phase");
+					ImGui::TableSetupColumn("Time");
+					ImGui::TableSetupColumn("Details");
+					ImGui::TableHeadersRow();
+					for (const auto& phase : StartupProfile::GetPhases())
+					{
+						ImGui::TableNextRow();
+						ImGui::TableNextColumn();
+						ImGui::Text("%*s%s", phase.Depth * 2, "", phase.Name);
+						ImGui::TableNextColumn();
+						ImGui::Text("%.2fms", phase.Milliseconds);
+						ImGui::TableNextColumn();
+						ImGui::TextUnformatted(phase.Detail.c_str());
+					}
+					ImGui::EndTable();
+				}
+				ImGui::EndTabItem();
+			}
 			ImGui::PushStyleColor(ImGuiCol_Button, 0);
 			ImGui::PushStyleColor(ImGuiCol_ButtonHovered, 0);
 			ImGui::PushStyleColor(ImGuiCol_ButtonActive, 0);
@@ -1368,6 +1558,28 @@ void winmain::Restart()
 	SDL_PushEvent(&event);
 }
 
+void winmain::LoadControllerDb()
+{
+	// Embedded SDL Game Controller DB is only decompressed once a joystick shows up.
+	if (ControllerDbLoaded)
+		return;
+	ControllerDbLoaded = true;
+
+	unsigned decompressedSize{};
+	const auto controllerDb = ImFontAtlas::DecompressCompressedStbData(
+		EmbeddedData::SDL_GameControllerDB_compressed_data,
+		EmbeddedData::SDL_GameControllerDB_compressed_size,
+		decompressedSize);
+	auto rw = SDL_RWFromMem(controllerDb, decompressedSize);
+	const auto added = SDL_GameControllerAddMappingsFromRW(rw, 1);
+	IM_FREE(controllerDb);
+	if (added < 0)
+	{
+		printf("Could not load game controller DB.\nSDL Error: %s\n", SDL_GetError());
+		SDL_ClearError();
+	}
+}
+
 void winmain::UpdateFrameRate()
 {
 	// UPS >= FPS
@@ -1434,6 +1646,47 @@ void winmain::RenderFrameTimeDialog()
 		ImGui::SameLine();
 		ImGui::SliderFloat("Window Size", &gfrWindow, 0.1f, 15, "%.3fsec", ImGuiSliderFlags_AlwaysClamp);
 
+		ImGui::Checkbox("Input Latency", &InputLatency::Enabled);
+		if (InputLatency::Enabled)
+		{
+			ImGui::SameLine();
+			if (ImGui::Button("Clear"))
+				InputLatency::Clear();
+
+			// Flipper press latency, from the SDL event timestamp to the end of each stage.
+			if (ImGui::BeginTable("Input Latency", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingFixedFit))
+			{
+				ImGui::TableSetupColumn("Stage");
+				ImGui::TableSetupColumn("Min");
+				ImGui::TableSetupColumn("Median");
+				ImGui::TableSetupColumn("P99");
+				ImGui::TableSetupColumn("Samples");
+				ImGui::TableHeadersRow();
+				for (auto index = 0; index < static_cast<int>(LatencyStage::Count); index++)
+				{
+					auto stage = static_cast<LatencyStage>(index);
+					auto stats = InputLatency::GetStats(stage);
+					ImGui::TableNextRow();
+					ImGui::TableNextColumn();
+					ImGui::TextUnformatted(InputLatency::StageName(stage));
+					ImGui::TableNextColumn();
+					ImGui::Text("%.2fms", stats.Min);
+					ImGui::TableNextColumn();
+					ImGui::Text("%.2fms", stats.Median);
+					ImGui::TableNextColumn();
+					ImGui::Text("%.2fms", stats.P99);
+					ImGui::TableNextColumn();
+					ImGui::Text("%d", stats.Samples);
+				}
+				ImGui::EndTable();
+			}
+		}
+
+		static bool renderStats = false;
+		ImGui::Checkbox("Render Stats", &renderStats);
+		if (renderStats)
+			render::StatsPlots();
+
 		{
 			float average = 0.0f, dev = 0.0f;
 			for (auto n : gfrDisplay)
@@ -1455,6 +1708,28 @@ void winmain::RenderFrameTimeDialog()
 	ImGui::PopStyleVar();
 }
 
+ImU32 winmain::HashDrawData(const ImDrawData* drawData)
+{
+	ImU32 hash = 0;
+	if (!drawData)
+		return hash;
+
+	hash = ImHashData(&drawData->DisplaySize, sizeof drawData->DisplaySize, hash);
+	for (auto index = 0; index < drawData->CmdListsCount; index++)
+	{
+		auto cmdList = drawData->CmdLists[index];
+		hash = ImHashData(cmdList->VtxBuffer.Data, cmdList->VtxBuffer.size_in_bytes(), hash);
+		hash = ImHashData(cmdList->IdxBuffer.Data, cmdList->IdxBuffer.size_in_bytes(), hash);
+		for (const auto& cmd : cmdList->CmdBuffer)
+		{
+			hash = ImHashData(&cmd.ClipRect, sizeof cmd.ClipRect, hash);
+			hash = ImHashData(&cmd.TextureId, sizeof cmd.TextureId, hash);
+			hash = ImHashData(&cmd.ElemCount, sizeof cmd.ElemCount, hash);
+		}
+	}
+	return hash;
+}
+
 void winmain::HybridSleep(DurationMs sleepTarget)
 {
 	static constexpr double StdDevFactor = 0.5;
@@ -75,6 +75,8 @@ public:
 	static bool HighScoresEnabled;
 	static bool DemoActive;
 	static int MainMenuHeight;
+	static std::string PrefPath;
+	static bool RedrawPending;
 
 	static int WinMain(LPCSTR lpCmdLine);
 	static int event_handler(const SDL_Event* event);
@@ -97,6 +99,7 @@ private:
 	static bool ShowAboutDialog;
 	static bool ShowImGuiDemo;
 	static bool ShowSpriteViewer;
+	static bool ShowBlitBenchmark;
 	static bool ShowExitPopup;
 	static double UpdateToFrameRatio;
 	static DurationMs TargetFrameTime;
@@ -107,10 +110,15 @@ private:
 	static unsigned gfrOffset;
 	static float gfrWindow;
 	static int CursorIdleCounter;
+	static unsigned IdleFrameCount;
+	static ImU32 PrevUiHash;
+	static bool ControllerDbLoaded;
 
 	static void RenderUi();
 	static void RenderFrameTimeDialog();
 	static void HybridSleep(DurationMs seconds);
+	static void LoadControllerDb();
 	static void MainLoop();
 	static void ImGuiMenuItemWShortcut(GameBindings binding, bool selected = false);
+	static ImU32 HashDrawData(const ImDrawData* drawData);
 };
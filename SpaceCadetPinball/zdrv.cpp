@@ -1,5 +1,7 @@
 #include "pch.h"
 #include "zdrv.h"
+
+#include "simd.h"
 #include "winmain.h"
 
 
@@ -32,13 +34,11 @@ int zmap_header_type::pad(int width)
 void zdrv::fill(zmap_header_type* zmap, int width, int height, int xOff, int yOff, uint16_t fillWord)
 {
 	auto dstPtr = &zmap->ZPtr1[zmap->Stride * yOff + xOff];
+	auto fillRow = Kernels(simd::Level).Fill;
 	for (int y = height; y > 0; --y)
 	{
-		for (int x = width; x > 0; --x)
-		{
-			*dstPtr++ = fillWord;
-		}
-		dstPtr += zmap->Stride - width;
+		fillRow(width, dstPtr, fillWord);
+		dstPtr += zmap->Stride;
 	}
 }
 
@@ -49,30 +49,20 @@ void zdrv::paint(int width, int height, gdrv_bitmap8* dstBmp, int dstBmpXOff, in
 {
 	assertm(srcBmp->BitmapType != BitmapTypes::Spliced, "Wrong bmp type");
 
+	dstBmp->MarkDirty(dstBmpXOff, dstBmpYOff, width, height);
 	auto srcPtr = &srcBmp->BmpBufPtr1[srcBmp->Stride * srcBmpYOff + srcBmpXOff];
 	auto dstPtr = &dstBmp->BmpBufPtr1[dstBmp->Stride * dstBmpYOff + dstBmpXOff];
 	auto srcPtrZ = &srcZMap->ZPtr1[srcZMap->Stride * srcZMapYOff + srcZMapXOff];
 	auto dstPtrZ = &dstZMap->ZPtr1[dstZMap->Stride * dstZMapYOff + dstZMapXOff];
 
+	auto paintRow = Kernels(simd::Level).Paint;
 	for (int y = height; y > 0; y--)
 	{
-		for (int x = width; x > 0; --x)
-		{
-			if (*dstPtrZ >= *srcPtrZ)
-			{
-				*dstPtr = *srcPtr;
-				*dstPtrZ = *srcPtrZ;
-			}
-			++srcPtr;
-			++dstPtr;
-			++srcPtrZ;
-			++dstPtrZ;
-		}
-
-		srcPtr += srcBmp->Stride - width;
-		dstPtr += dstBmp->Stride - width;
-		srcPtrZ += srcZMap->Stride - width;
-		dstPtrZ += dstZMap->Stride - width;
+		paintRow(width, dstPtr, dstPtrZ, srcPtr, srcPtrZ);
+		srcPtr += srcBmp->Stride;
+		dstPtr += dstBmp->Stride;
+		srcPtrZ += srcZMap->Stride;
+		dstPtrZ += dstZMap->Stride;
 	}
 }
 
@@ -82,26 +72,45 @@ void zdrv::paint_flat(int width, int height, gdrv_bitmap8* dstBmp, int dstBmpXOf
 {
 	assertm(srcBmp->BitmapType != BitmapTypes::Spliced, "Wrong bmp type");
 
+	dstBmp->MarkDirty(dstBmpXOff, dstBmpYOff, width, height);
 	auto dstPtr = &dstBmp->BmpBufPtr1[dstBmp->Stride * dstBmpYOff + dstBmpXOff];
 	auto srcPtr = &srcBmp->BmpBufPtr1[srcBmp->Stride * srcBmpYOff + srcBmpXOff];
 	auto zPtr = &zMap->ZPtr1[zMap->Stride * dstZMapYOff + dstZMapXOff];
 
-	for (int y = height; y > 0; y--)
+	auto paintRow = Kernels(simd::Level).PaintFlat;
+	if (!srcBmp->RowSpans.empty())
 	{
-		for (int x = width; x > 0; --x)
+		// Only opaque runs go through the depth test.
+		auto srcEnd = srcBmpXOff + width;
+		for (int y = srcBmpYOff; y < srcBmpYOff + height; y++)
 		{
-			if ((*srcPtr).Color && *zPtr > depth)
+			for (auto index = srcBmp->RowSpans[y]; index < srcBmp->RowSpans[y + 1]; index++)
 			{
-				*dstPtr = *srcPtr;
+				const auto& span = srcBmp->OpaqueSpans[index];
+				if (span.Start >= srcEnd)
+					break;
+
+				auto start = std::max(static_cast<int>(span.Start), srcBmpXOff);
+				auto end = std::min(span.Start + span.Length, srcEnd);
+				if (start < end)
+				{
+					auto offset = start - srcBmpXOff;
+					paintRow(end - start, dstPtr + offset, zPtr + offset, srcPtr + offset, depth);
+				}
 			}
-			++srcPtr;
-			++dstPtr;
-			++zPtr;
+			srcPtr += srcBmp->Stride;
+			dstPtr += dstBmp->Stride;
+			zPtr += zMap->Stride;
 		}
+		return;
+	}
 
-		srcPtr += srcBmp->Stride - width;
-		dstPtr += dstBmp->Stride - width;
-		zPtr += zMap->Stride - width;
+	for (int y = height; y > 0; y--)
+	{
+		paintRow(width, dstPtr, zPtr, srcPtr, depth);
+		srcPtr += srcBmp->Stride;
+		dstPtr += dstBmp->Stride;
+		zPtr += zMap->Stride;
 	}
 }
 
@@ -151,3 +160,242 @@ void zdrv::FlipZMapHorizontally(const zmap_header_type& zMap)
 		src -= zMap.Stride + zMap.Width;
 	}
 }
+
+const zdrv_row_kernels& zdrv::Kernels(SimdLevel level)
+{
+	static const zdrv_row_kernels scalar{paint_row, paint_flat_row, fill_row};
+#ifdef SIMD_SSE2
+	static const zdrv_row_kernels sse2{paint_row_sse2, paint_flat_row_sse2, fill_row_sse2};
+#endif
+#ifdef SIMD_AVX2
+	static const zdrv_row_kernels avx2{paint_row_avx2, paint_flat_row_avx2, fill_row_avx2};
+#endif
+#ifdef SIMD_NEON
+	static const zdrv_row_kernels neon{paint_row_neon, paint_flat_row_neon, fill_row_neon};
+#endif
+
+	switch (level)
+	{
+#ifdef SIMD_SSE2
+	case SimdLevel::Sse2:
+		return sse2;
+#endif
+#ifdef SIMD_AVX2
+	case SimdLevel::Avx2:
+		return avx2;
+#endif
+#ifdef SIMD_NEON
+	case SimdLevel::Neon:
+		return neon;
+#endif
+	default:
+		return scalar;
+	}
+}
+
+void zdrv::paint_row(int width, ColorRgba* dstPtr, uint16_t* dstPtrZ, const ColorRgba* srcPtr, const uint16_t* srcPtrZ)
+{
+	for (int x = 0; x < width; x++)
+	{
+		if (dstPtrZ[x] >= srcPtrZ[x])
+		{
+			dstPtr[x] = srcPtr[x];
+			dstPtrZ[x] = srcPtrZ[x];
+		}
+	}
+}
+
+void zdrv::paint_flat_row(int width, ColorRgba* dstPtr, const uint16_t* zPtr, const ColorRgba* srcPtr, uint16_t depth)
+{
+	for (int x = 0; x < width; x++)
+	{
+		if (srcPtr[x].Color && zPtr[x] > depth)
+			dstPtr[x] = srcPtr[x];
+	}
+}
+
+void zdrv::fill_row(int width, uint16_t* dstPtr, uint16_t fillWord)
+{
+	for (int x = 0; x < width; x++)
+		dstPtr[x] = fillWord;
+}
+
+#ifdef SIMD_SSE2
+void zdrv::paint_row_sse2(int width, ColorRgba* dstPtr, uint16_t* dstPtrZ, const ColorRgba* srcPtr,
+                          const uint16_t* srcPtrZ)
+{
+	const auto zero = _mm_setzero_si128();
+	int x = 0;
+	for (; x + 8 <= width; x += 8)
+	{
+		auto srcZ = _mm_loadu_si128(reinterpret_cast<const __m128i*>(srcPtrZ + x));
+		auto dstZ = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dstPtrZ + x));
+
+		// SSE2 has no unsigned 16-bit compare: dstZ >= srcZ when srcZ -sat dstZ is zero.
+		auto diff = _mm_subs_epu16(srcZ, dstZ);
+		auto mask = _mm_cmpeq_epi16(diff, zero);
+		if (!_mm_movemask_epi8(mask))
+			continue;
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dstPtrZ + x), _mm_sub_epi16(srcZ, diff));
+		auto maskLo = _mm_unpacklo_epi16(mask, mask);
+		auto maskHi = _mm_unpackhi_epi16(mask, mask);
+		auto src = reinterpret_cast<const __m128i*>(srcPtr + x);
+		auto dst = reinterpret_cast<__m128i*>(dstPtr + x);
+		auto srcLo = _mm_loadu_si128(src), srcHi = _mm_loadu_si128(src + 1);
+		auto dstLo = _mm_loadu_si128(dst), dstHi = _mm_loadu_si128(dst + 1);
+		_mm_storeu_si128(dst, _mm_or_si128(_mm_and_si128(maskLo, srcLo), _mm_andnot_si128(maskLo, dstLo)));
+		_mm_storeu_si128(dst + 1, _mm_or_si128(_mm_and_si128(maskHi, srcHi), _mm_andnot_si128(maskHi, dstHi)));
+	}
+	paint_row(width - x, dstPtr + x, dstPtrZ + x, srcPtr + x, srcPtrZ + x);
+}
+
+void zdrv::paint_flat_row_sse2(int width, ColorRgba* dstPtr, const uint16_t* zPtr, const ColorRgba* srcPtr,
+                               uint16_t depth)
+{
+	const auto zero = _mm_setzero_si128();
+	const auto depthV = _mm_set1_epi16(static_cast<short>(depth));
+	int x = 0;
+	for (; x + 8 <= width; x += 8)
+	{
+		// Keep destination where zPtr <= depth or source is transparent.
+		auto z = _mm_loadu_si128(reinterpret_cast<const __m128i*>(zPtr + x));
+		auto keepZ = _mm_cmpeq_epi16(_mm_subs_epu16(z, depthV), zero);
+		if (_mm_movemask_epi8(keepZ) == 0xFFFF)
+			continue;
+
+		auto src = reinterpret_cast<const __m128i*>(srcPtr + x);
+		auto dst = reinterpret_cast<__m128i*>(dstPtr + x);
+		auto srcLo = _mm_loadu_si128(src), srcHi = _mm_loadu_si128(src + 1);
+		auto keepLo = _mm_or_si128(_mm_unpacklo_epi16(keepZ, keepZ), _mm_cmpeq_epi32(srcLo, zero));
+		auto keepHi = _mm_or_si128(_mm_unpackhi_epi16(keepZ, keepZ), _mm_cmpeq_epi32(srcHi, zero));
+		auto dstLo = _mm_loadu_si128(dst), dstHi = _mm_loadu_si128(dst + 1);
+		_mm_storeu_si128(dst, _mm_or_si128(_mm_and_si128(keepLo, dstLo), _mm_andnot_si128(keepLo, srcLo)));
+		_mm_storeu_si128(dst + 1, _mm_or_si128(_mm_and_si128(keepHi, dstHi), _mm_andnot_si128(keepHi, srcHi)));
+	}
+	paint_flat_row(width - x, dstPtr + x, zPtr + x, srcPtr + x, depth);
+}
+
+void zdrv::fill_row_sse2(int width, uint16_t* dstPtr, uint16_t fillWord)
+{
+	const auto fill = _mm_set1_epi16(static_cast<short>(fillWord));
+	int x = 0;
+	for (; x + 8 <= width; x += 8)
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dstPtr + x), fill);
+	fill_row(width - x, dstPtr + x, fillWord);
+}
+#endif
+
+#ifdef SIMD_AVX2
+SIMD_TARGET_AVX2 void zdrv::paint_row_avx2(int width, ColorRgba* dstPtr, uint16_t* dstPtrZ, const ColorRgba* srcPtr,
+                                           const uint16_t* srcPtrZ)
+{
+	const auto zero = _mm256_setzero_si256();
+	int x = 0;
+	for (; x + 16 <= width; x += 16)
+	{
+		auto srcZ = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(srcPtrZ + x));
+		auto dstZ = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dstPtrZ + x));
+		auto mask = _mm256_cmpeq_epi16(_mm256_subs_epu16(srcZ, dstZ), zero);
+		if (!_mm256_movemask_epi8(mask))
+			continue;
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dstPtrZ + x), _mm256_min_epu16(srcZ, dstZ));
+		auto maskLo = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(mask));
+		auto maskHi = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(mask, 1));
+		auto src = reinterpret_cast<const __m256i*>(srcPtr + x);
+		auto dst = reinterpret_cast<__m256i*>(dstPtr + x);
+		_mm256_storeu_si256(dst, _mm256_blendv_epi8(_mm256_loadu_si256(dst), _mm256_loadu_si256(src), maskLo));
+		_mm256_storeu_si256(dst + 1, _mm256_blendv_epi8(_mm256_loadu_si256(dst + 1), _mm256_loadu_si256(src + 1),
+		                                                 maskHi));
+	}
+	paint_row(width - x, dstPtr + x, dstPtrZ + x, srcPtr + x, srcPtrZ + x);
+}
+
+SIMD_TARGET_AVX2 void zdrv::paint_flat_row_avx2(int width, ColorRgba* dstPtr, const uint16_t* zPtr,
+                                                const ColorRgba* srcPtr, uint16_t depth)
+{
+	const auto zero = _mm256_setzero_si256();
+	const auto depthV = _mm256_set1_epi16(static_cast<short>(depth));
+	int x = 0;
+	for (; x + 16 <= width; x += 16)
+	{
+		auto z = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(zPtr + x));
+		auto keepZ = _mm256_cmpeq_epi16(_mm256_subs_epu16(z, depthV), zero);
+		if (_mm256_movemask_epi8(keepZ) == -1)
+			continue;
+
+		auto src = reinterpret_cast<const __m256i*>(srcPtr + x);
+		auto dst = reinterpret_cast<__m256i*>(dstPtr + x);
+		auto srcLo = _mm256_loadu_si256(src), srcHi = _mm256_loadu_si256(src + 1);
+		auto keepLo = _mm256_or_si256(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(keepZ)),
+		                              _mm256_cmpeq_epi32(srcLo, zero));
+		auto keepHi = _mm256_or_si256(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(keepZ, 1)),
+		                              _mm256_cmpeq_epi32(srcHi, zero));
+		_mm256_storeu_si256(dst, _mm256_blendv_epi8(srcLo, _mm256_loadu_si256(dst), keepLo));
+		_mm256_storeu_si256(dst + 1, _mm256_blendv_epi8(srcHi, _mm256_loadu_si256(dst + 1), keepHi));
+	}
+	paint_flat_row(width - x, dstPtr + x, zPtr + x, srcPtr + x, depth);
+}
+
+SIMD_TARGET_AVX2 void zdrv::fill_row_avx2(int width, uint16_t* dstPtr, uint16_t fillWord)
+{
+	const auto fill = _mm256_set1_epi16(static_cast<short>(fillWord));
+	int x = 0;
+	for (; x + 16 <= width; x += 16)
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dstPtr + x), fill);
+	fill_row(width - x, dstPtr + x, fillWord);
+}
+#endif
+
+#ifdef SIMD_NEON
+void zdrv::paint_row_neon(int width, ColorRgba* dstPtr, uint16_t* dstPtrZ, const ColorRgba* srcPtr,
+                          const uint16_t* srcPtrZ)
+{
+	int x = 0;
+	for (; x + 8 <= width; x += 8)
+	{
+		auto srcZ = vld1q_u16(srcPtrZ + x);
+		auto dstZ = vld1q_u16(dstPtrZ + x);
+		auto mask = vreinterpretq_s16_u16(vcgeq_u16(dstZ, srcZ));
+		vst1q_u16(dstPtrZ + x, vminq_u16(srcZ, dstZ));
+
+		// Sign extension widens the 16-bit lane mask into a 32-bit one.
+		auto maskLo = vreinterpretq_u32_s32(vmovl_s16(vget_low_s16(mask)));
+		auto maskHi = vreinterpretq_u32_s32(vmovl_s16(vget_high_s16(mask)));
+		auto src = reinterpret_cast<const uint32_t*>(srcPtr + x);
+		auto dst = reinterpret_cast<uint32_t*>(dstPtr + x);
+		vst1q_u32(dst, vbslq_u32(maskLo, vld1q_u32(src), vld1q_u32(dst)));
+		vst1q_u32(dst + 4, vbslq_u32(maskHi, vld1q_u32(src + 4), vld1q_u32(dst + 4)));
+	}
+	paint_row(width - x, dstPtr + x, dstPtrZ + x, srcPtr + x, srcPtrZ + x);
+}
+
+void zdrv::paint_flat_row_neon(int width, ColorRgba* dstPtr, const uint16_t* zPtr, const ColorRgba* srcPtr,
+                               uint16_t depth)
+{
+	const auto depthV = vdupq_n_u16(depth);
+	int x = 0;
+	for (; x + 8 <= width; x += 8)
+	{
+		auto writeZ = vreinterpretq_s16_u16(vcgtq_u16(vld1q_u16(zPtr + x), depthV));
+		auto src = reinterpret_cast<const uint32_t*>(srcPtr + x);
+		auto dst = reinterpret_cast<uint32_t*>(dstPtr + x);
+		auto srcLo = vld1q_u32(src), srcHi = vld1q_u32(src + 4);
+		auto writeLo = vandq_u32(vreinterpretq_u32_s32(vmovl_s16(vget_low_s16(writeZ))), vtstq_u32(srcLo, srcLo));
+		auto writeHi = vandq_u32(vreinterpretq_u32_s32(vmovl_s16(vget_high_s16(writeZ))), vtstq_u32(srcHi, srcHi));
+		vst1q_u32(dst, vbslq_u32(writeLo, srcLo, vld1q_u32(dst)));
+		vst1q_u32(dst + 4, vbslq_u32(writeHi, srcHi, vld1q_u32(dst + 4)));
+	}
+	paint_flat_row(width - x, dstPtr + x, zPtr + x, srcPtr + x, depth);
+}
+
+void zdrv::fill_row_neon(int width, uint16_t* dstPtr, uint16_t fillWord)
+{
+	const auto fill = vdupq_n_u16(fillWord);
+	int x = 0;
+	for (; x + 8 <= width; x += 8)
+		vst1q_u16(dstPtr + x, fill);
+	fill_row(width - x, dstPtr + x, fillWord);
+}
+#endif
@@ -1,6 +1,14 @@
 #pragma once
 #include "gdrv.h"
 
+// One row of each zdrv blit, implemented per SIMD level.
+struct zdrv_row_kernels
+{
+	void (*Paint)(int width, ColorRgba* dstPtr, uint16_t* dstPtrZ, const ColorRgba* srcPtr, const uint16_t* srcPtrZ);
+	void (*PaintFlat)(int width, ColorRgba* dstPtr, const uint16_t* zPtr, const ColorRgba* srcPtr, uint16_t depth);
+	void (*Fill)(int width, uint16_t* dstPtr, uint16_t fillWord);
+};
+
 struct zmap_header_type
 {
 	zmap_header_type(int width, int height, int stride);
@@ -27,4 +35,26 @@ public:
 	                       int srcBmpXOff, int srcBmpYOff, uint16_t depth);
 	static void CreatePreview(zmap_header_type& zMap);
 	static void FlipZMapHorizontally(const zmap_header_type& zMap);
+private:
+	static const zdrv_row_kernels& Kernels(SimdLevel level);
+	static void paint_row(int width, ColorRgba* dstPtr, uint16_t* dstPtrZ, const ColorRgba* srcPtr,
+	                      const uint16_t* srcPtrZ);
+	static void paint_row_sse2(int width, ColorRgba* dstPtr, uint16_t* dstPtrZ, const ColorRgba* srcPtr,
+	                           const uint16_t* srcPtrZ);
+	static void paint_row_avx2(int width, ColorRgba* dstPtr, uint16_t* dstPtrZ, const ColorRgba* srcPtr,
+	                           const uint16_t* srcPtrZ);
+	static void paint_row_neon(int width, ColorRgba* dstPtr, uint16_t* dstPtrZ, const ColorRgba* srcPtr,
+	                           const uint16_t* srcPtrZ);
+	static void paint_flat_row(int width, ColorRgba* dstPtr, const uint16_t* zPtr, const ColorRgba* srcPtr,
+	                           uint16_t depth);
+	static void paint_flat_row_sse2(int width, ColorRgba* dstPtr, const uint16_t* zPtr, const ColorRgba* srcPtr,
+	                                uint16_t depth);
+	static void paint_flat_row_avx2(int width, ColorRgba* dstPtr, const uint16_t* zPtr, const ColorRgba* srcPtr,
+	                                uint16_t depth);
+	static void paint_flat_row_neon(int width, ColorRgba* dstPtr, const uint16_t* zPtr, const ColorRgba* srcPtr,
+	                                uint16_t depth);
+	static void fill_row(int width, uint16_t* dstPtr, uint16_t fillWord);
+	static void fill_row_sse2(int width, uint16_t* dstPtr, uint16_t fillWord);
+	static void fill_row_avx2(int width, uint16_t* dstPtr, uint16_t fillWord);
+	static void fill_row_neon(int width, uint16_t* dstPtr, uint16_t fillWord);
 };